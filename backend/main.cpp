@@ -5,20 +5,12 @@
 #include <vector>
 #include <algorithm>
 #include <ctime>
+#include <chrono>
+#include <unordered_map>
+#include "student_store.h"
 
 using namespace std;
 
-// Student structure
-struct Student {
-    int id;
-    string name;
-    int age;
-    string course;
-    string email;
-    float gpa;
-    int marks;
-};
-
 // Function prototypes
 void displayMenu();
 void addStudent();
@@ -27,16 +19,47 @@ void searchStudent();
 void updateStudent();
 void deleteStudent();
 vector<Student> loadStudents();
-void saveStudents(const vector<Student>& students);
-int generateNewId();
 void clearScreen();
 string trim(const string& str);
+int runBatch(istream& input);
 
 const string FILENAME = "students.txt";
 
-int main() {
+// One parsed --batch line
+struct BatchCommand {
+    int lineNumber;
+    string name;        // add, update, delete, search, search name
+    Student student;    // add / update
+    int id;             // delete / search
+    string text;        // search name
+};
+
+// Shared with a running server.cpp, so each side sees the other's writes
+StreamPersistence persistence;
+StudentStore store;
+
+int main(int argc, char* argv[]) {
     int choice;
     
+    if (!store.open(FILENAME, &persistence)) {
+        cerr << "Unable to open the shared student store: " << store.error() << "\n";
+        return 1;
+    }
+    
+    // srms --batch <file>   or   srms --batch -   (commands on stdin)
+    if (argc > 1 && string(argv[1]) == "--batch") {
+        string source = argc > 2 ? argv[2] : "-";
+        if (source == "-") {
+            return runBatch(cin);
+        }
+        ifstream commands(source);
+        if (!commands.is_open()) {
+            cerr << "Unable to open command file: " << source << "\n";
+            return 1;
+        }
+        return runBatch(commands);
+    }
+    
     cout << "========================================\n";
     cout << "  STUDENT RECORD MANAGEMENT SYSTEM\n";
     cout << "========================================\n\n";
@@ -104,8 +127,8 @@ void addStudent() {
         cin >> student.id;
         cin.ignore();
     } else {
-        student.id = generateNewId();
-        cout << "Student ID (Auto-generated): " << student.id << "\n";
+        student.id = 0;
+        cout << "Student ID will be auto-generated\n";
     }
     
     cout << "Enter Name: ";
@@ -129,15 +152,10 @@ void addStudent() {
     cin >> student.marks;
     cin.ignore();
     
-    // Save to file
-    ofstream file(FILENAME, ios::app);
-    if (file.is_open()) {
-        file << student.id << "|" << student.name << "|" << student.age << "|" 
-             << student.course << "|" << student.email << "|" << student.gpa << "|" << student.marks << "\n";
-        file.close();
-        cout << "\n✓ Student added successfully!\n";
+    if (store.add(student)) {
+        cout << "\n✓ Student added successfully! (ID: " << student.id << ")\n";
     } else {
-        cout << "\n✗ Error: Unable to open file!\n";
+        cout << "\n✗ Error: " << store.error() << "\n";
     }
 }
 
@@ -276,8 +294,13 @@ void updateStudent() {
             cin >> student.marks;
             cin.ignore();
             
-            saveStudents(students);
-            cout << "\n✓ Student updated successfully!\n";
+            // Only this record is written back, so concurrent changes to
+            // other students (e.g. from the server) are kept
+            if (store.update(student)) {
+                cout << "\n✓ Student updated successfully!\n";
+            } else {
+                cout << "\n✗ Error: " << store.error() << "\n";
+            }
             break;
         }
     }
@@ -288,8 +311,6 @@ void updateStudent() {
 }
 
 void deleteStudent() {
-    vector<Student> students = loadStudents();
-    
     cout << "\n--- Delete Student ---\n";
     cout << "Enter Student ID to delete: ";
     
@@ -297,94 +318,24 @@ void deleteStudent() {
     cin >> deleteId;
     cin.ignore();
     
-    auto it = remove_if(students.begin(), students.end(), 
-                        [deleteId](const Student& s) { return s.id == deleteId; });
-    
-    if (it != students.end()) {
-        students.erase(it, students.end());
-        saveStudents(students);
+    if (store.remove(deleteId)) {
         cout << "\n✓ Student deleted successfully!\n";
     } else {
-        cout << "\n✗ Student with ID " << deleteId << " not found.\n";
+        cout << "\n✗ Error: " << store.error() << "\n";
     }
 }
 
+// Copies the current records out of the shared store (no file parsing)
 vector<Student> loadStudents() {
-    vector<Student> students;
-    ifstream file(FILENAME);
-    
-    if (file.is_open()) {
-        string line;
-        while (getline(file, line)) {
-            if (line.empty()) continue;
-            
-            Student student;
-            stringstream ss(line);
-            string temp;
-            
-            getline(ss, temp, '|');
-            student.id = stoi(temp);
-            
-            getline(ss, student.name, '|');
-            
-            getline(ss, temp, '|');
-            student.age = stoi(temp);
-            
-            getline(ss, student.course, '|');
-            getline(ss, student.email, '|');
-            
-            getline(ss, temp, '|');
-            student.gpa = stof(temp);
-            
-            getline(ss, temp, '|');
-            if (!temp.empty()) {
-                student.marks = stoi(temp);
-            } else {
-                student.marks = 0;
-            }
-            
-            students.push_back(student);
-        }
-        file.close();
-    }
-    
-    return students;
-}
-
-void saveStudents(const vector<Student>& students) {
-    ofstream file(FILENAME);
-    
-    if (file.is_open()) {
-        for (const auto& student : students) {
-            file << student.id << "|" << student.name << "|" << student.age << "|" 
-                 << student.course << "|" << student.email << "|" << student.gpa << "|" << student.marks << "\n";
-        }
-        file.close();
-    }
-}
-
-int generateNewId() {
-    vector<Student> students = loadStudents();
-    
-    if (students.empty()) {
-        return 1001; // Starting ID
-    }
-    
-    int maxId = 0;
-    for (const auto& student : students) {
-        if (student.id > maxId) {
-            maxId = student.id;
-        }
-    }
-    
-    return maxId + 1;
+    return store.readAll();
 }
 
 void clearScreen() {
     #ifdef _WIN32
         system("cls");
     #else
-        system("clear");
+        // ANSI clear + home; avoids spawning a shell on every menu loop
+        cout << "\033[2J\033[H" << flush;
     #endif
 }
 
@@ -396,3 +347,188 @@ string trim(const string& str) {
     size_t last = str.find_last_not_of(' ');
     return str.substr(first, (last - first + 1));
 }
+
+
+// Applies a stream of commands to the data file in one pass:
+//   add <ID|Name|Age|Course|Email|GPA|Marks>     (ID 0 = auto-generate)
+//   update <ID|Name|Age|Course|Email|GPA|Marks>
+//   delete <ID>
+//   search <ID>
+//   search name <text>
+// Blank lines and lines starting with # are skipped. All commands are read
+// and parsed first, so a slow or stalled input never holds the store lock;
+// then the records are read once, every command runs against memory, and
+// they are saved once at the end.
+int runBatch(istream& input) {
+    typedef chrono::steady_clock Clock;
+    
+    int added = 0, updated = 0, removed = 0, searched = 0, found = 0, failed = 0;
+    int lineNumber = 0;
+    double parseMs = 0, loadMs = 0, applyMs = 0;
+    Clock::time_point parseStart = Clock::now();
+    Clock::time_point loadStart, saveStart;
+    
+    vector<BatchCommand> commands;
+    string line;
+    while (getline(input, line)) {
+        lineNumber++;
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        line = trim(line);
+        if (line.empty() || line[0] == '#') continue;
+        
+        size_t space = line.find(' ');
+        BatchCommand command;
+        command.lineNumber = lineNumber;
+        command.name = line.substr(0, space);
+        command.id = 0;
+        string args = (space == string::npos) ? "" : trim(line.substr(space + 1));
+        
+        try {
+            if (command.name == "add" || command.name == "update") {
+                command.student = parseStudentRecord(args);
+                if (!StudentStore::fits(command.student)) {
+                    cerr << "Line " << lineNumber << ": name, course or email is too long\n";
+                    failed++;
+                    continue;
+                }
+            } else if (command.name == "delete") {
+                command.id = stoi(args);
+            } else if (command.name == "search") {
+                if (args.compare(0, 5, "name ") == 0) {
+                    command.name = "search name";
+                    command.text = trim(args.substr(5));
+                } else {
+                    command.id = stoi(args);
+                }
+            } else {
+                cerr << "Line " << lineNumber << ": unknown command '" << command.name << "'\n";
+                failed++;
+                continue;
+            }
+        } catch (const exception&) {
+            cerr << "Line " << lineNumber << ": malformed arguments\n";
+            failed++;
+            continue;
+        }
+        commands.push_back(command);
+    }
+    parseMs = chrono::duration<double, milli>(Clock::now() - parseStart).count();
+    
+    // The store stays locked while the parsed commands are applied, so other
+    // processes can't interleave writes with them; the result is written
+    // back once. Search output is collected and printed after unlocking.
+    string searchOutput;
+    loadStart = Clock::now();
+    bool saved = store.transaction([&](vector<Student>& students) {
+        loadMs = chrono::duration<double, milli>(Clock::now() - loadStart).count();
+        Clock::time_point applyStart = Clock::now();
+        
+        // ID -> position; deleted rows are flagged and dropped when saving
+        unordered_map<int, size_t> positionById;
+        vector<bool> deleted(students.size(), false);
+        int maxId = 1000;
+        for (size_t i = 0; i < students.size(); i++) {
+            positionById[students[i].id] = i;
+            maxId = max(maxId, students[i].id);
+        }
+        
+        for (const BatchCommand& command : commands) {
+            if (command.name == "add") {
+                Student student = command.student;
+                if (student.id == 0) {
+                    student.id = maxId + 1;
+                }
+                if (positionById.count(student.id)) {
+                    cerr << "Line " << command.lineNumber << ": ID " << student.id << " already exists\n";
+                    failed++;
+                    continue;
+                }
+                positionById[student.id] = students.size();
+                students.push_back(student);
+                deleted.push_back(false);
+                maxId = max(maxId, student.id);
+                added++;
+            } else if (command.name == "update") {
+                auto it = positionById.find(command.student.id);
+                if (it == positionById.end()) {
+                    cerr << "Line " << command.lineNumber << ": ID " << command.student.id << " not found\n";
+                    failed++;
+                    continue;
+                }
+                students[it->second] = command.student;
+                updated++;
+            } else if (command.name == "delete") {
+                auto it = positionById.find(command.id);
+                if (it == positionById.end()) {
+                    cerr << "Line " << command.lineNumber << ": ID " << command.id << " not found\n";
+                    failed++;
+                    continue;
+                }
+                deleted[it->second] = true;
+                positionById.erase(it);
+                removed++;
+            } else if (command.name == "search name") {
+                searched++;
+                bool any = false;
+                for (size_t i = 0; i < students.size(); i++) {
+                    if (!deleted[i] && students[i].name.find(command.text) != string::npos) {
+                        searchOutput += formatStudentRecord(students[i]);
+                        any = true;
+                    }
+                }
+                if (any) found++;
+            } else {
+                searched++;
+                auto it = positionById.find(command.id);
+                if (it != positionById.end()) {
+                    searchOutput += formatStudentRecord(students[it->second]);
+                    found++;
+                }
+            }
+        }
+        applyMs = chrono::duration<double, milli>(Clock::now() - applyStart).count();
+        
+        saveStart = Clock::now();
+        if (added + updated + removed == 0) {
+            return false;
+        }
+        vector<Student> remaining;
+        remaining.reserve(students.size());
+        for (size_t i = 0; i < students.size(); i++) {
+            if (!deleted[i]) {
+                remaining.push_back(students[i]);
+            }
+        }
+        students.swap(remaining);
+        return true;
+    });
+    double saveMs = chrono::duration<double, milli>(Clock::now() - saveStart).count();
+    
+    cout << searchOutput;
+    
+    // The changes only ever reached the in-memory copy, so none of them
+    // count as applied
+    int unsaved = 0;
+    if (!saved) {
+        cerr << "Error: " << store.error() << "; nothing was saved";
+        cerr << (searched > 0 ? " (search results above include the unsaved changes)\n" : "\n");
+        unsaved = added + updated + removed;
+        failed += max(unsaved, 1);
+        added = updated = removed = 0;
+    }
+    
+    cerr << "\n========== BATCH SUMMARY ==========\n";
+    cerr << "Commands: " << lineNumber << " lines\n";
+    cerr << "Added: " << added << "  Updated: " << updated << "  Deleted: " << removed << "\n";
+    if (unsaved > 0) {
+        cerr << "Not saved: " << unsaved << " changes applied in memory only\n";
+    }
+    cerr << "Searches: " << searched << " (" << found << " with results)\n";
+    cerr << "Failed: " << failed << "\n";
+    cerr << "Parse: " << parseMs << " ms  Load: " << loadMs << " ms  Apply: " << applyMs
+         << " ms  Save: " << saveMs << " ms\n";
+    
+    return failed > 0 ? 2 : 0;
+}
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "persistence.h"
+
+using namespace std;
+
+// Compares commit latency and throughput of the persistence backends.
+// Usage: persist_bench [appends] [snapshot records] [snapshot rounds]
+
+const string BENCH_FILE = "persist_bench.txt";
+
+string makeRecord(int id) {
+    return to_string(id) + "|Student " + to_string(id) + "|20|Computer Science|student" +
+           to_string(id) + "@example.com|3.75|80\n";
+}
+
+void benchAppends(PersistenceBackend* backend, int count) {
+    remove(BENCH_FILE.c_str());
+    vector<double> latencies;
+    latencies.reserve(count);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        string record = makeRecord(1001 + i);
+        chrono::steady_clock::time_point before = chrono::steady_clock::now();
+        if (!backend->append(BENCH_FILE, record)) {
+            cerr << backend->name() << ": append failed\n";
+            return;
+        }
+        latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - before).count());
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (double latency : latencies) total += latency;
+
+    cout << "  " << backend->name() << " append: "
+         << count / seconds << " commits/s, avg " << total / count << " us"
+         << ", p50 " << latencies[count / 2] << " us"
+         << ", p99 " << latencies[min(count - 1, count * 99 / 100)] << " us"
+         << ", max " << latencies.back() << " us\n";
+}
+
+void benchSnapshots(PersistenceBackend* backend, int records, int rounds) {
+    string data;
+    for (int i = 0; i < records; i++) {
+        data += makeRecord(1001 + i);
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        if (!backend->writeSnapshot(BENCH_FILE, data)) {
+            cerr << backend->name() << ": snapshot failed\n";
+            return;
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "  " << backend->name() << " snapshot: " << records << " records ("
+         << data.size() / 1024 << " KB), avg " << seconds * 1000 / rounds << " ms, "
+         << data.size() * rounds / seconds / (1024 * 1024) << " MB/s\n";
+}
+
+int main(int argc, char* argv[]) {
+    int appends = argc > 1 ? atoi(argv[1]) : 2000;
+    int snapshotRecords = argc > 2 ? atoi(argv[2]) : 50000;
+    int snapshotRounds = argc > 3 ? atoi(argv[3]) : 20;
+    if (appends <= 0 || snapshotRecords <= 0 || snapshotRounds <= 0) {
+        cerr << "Usage: persist_bench [appends] [snapshot records] [snapshot rounds] (all positive)\n";
+        return 1;
+    }
+
+    PersistenceBackend* stream = createPersistence(false);
+    PersistenceBackend* durableStream = new StreamPersistence(true);
+    PersistenceBackend* ring = createPersistence(true);
+
+    cout << "========================================\n";
+    cout << "  SRMS Persistence Benchmark\n";
+    cout << "========================================\n";
+    if (string(ring->name()) != "io_uring") {
+        cout << "io_uring unavailable; only the fstream backends are measured\n";
+    }
+    cout << "Note: plain fstream leaves data in the OS cache; compare io_uring with fstream+fsync,\n";
+    cout << "      which both make every commit durable\n\n";
+
+    benchAppends(stream, appends);
+    benchAppends(durableStream, appends);
+    if (string(ring->name()) == "io_uring") {
+        benchAppends(ring, appends);
+    }
+
+    benchSnapshots(stream, snapshotRecords, snapshotRounds);
+    benchSnapshots(durableStream, snapshotRecords, snapshotRounds);
+    if (string(ring->name()) == "io_uring") {
+        benchSnapshots(ring, snapshotRecords, snapshotRounds);
+    }
+
+    remove(BENCH_FILE.c_str());
+    delete stream;
+    delete durableStream;
+    delete ring;
+    return 0;
+}
@@ -0,0 +1,409 @@
+// Durable writes for the student data file.
+//
+// Two backends share one interface:
+//   StreamPersistence  - the original blocking ofstream path (all platforms),
+//                        optionally fsyncing each commit
+//   IoUringPersistence - Linux io_uring: batched submissions, write+fsync
+//                        linked so a commit is one round trip to the kernel
+//
+// Both replace the file on a snapshot by writing a temp file and renaming
+// it over the target, so a crash leaves either the old or the new file.
+//
+// createPersistence() falls back to the stream backend whenever io_uring is
+// not requested or not available (non-Linux, old kernel, seccomp, ...).
+
+#ifndef SRMS_PERSISTENCE_H
+#define SRMS_PERSISTENCE_H
+
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <stdint.h>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#endif
+
+class PersistenceBackend {
+public:
+    virtual ~PersistenceBackend() {}
+
+    // Appends one or more complete records to the end of the file
+    virtual bool append(const std::string& path, const std::string& data) = 0;
+
+    // Replaces the whole file with data
+    virtual bool writeSnapshot(const std::string& path, const std::string& data) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+// Flushes a closed file's data to disk
+inline bool syncFile(const std::string& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, 0,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    bool ok = FlushFileBuffers(file) != 0;
+    CloseHandle(file);
+    return ok;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#endif
+}
+
+// Atomically puts tempPath in place of path
+inline bool replaceFile(const std::string& tempPath, const std::string& path) {
+#ifdef _WIN32
+    return MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+}
+
+class StreamPersistence : public PersistenceBackend {
+public:
+    // durable: fsync every commit, matching what the io_uring backend does
+    explicit StreamPersistence(bool durable = false) : durable(durable) {}
+
+    bool append(const std::string& path, const std::string& data) {
+        std::ofstream file(path.c_str(), std::ios::app);
+        if (!file.is_open()) {
+            return false;
+        }
+        file << data;
+        file.close();
+        return !file.fail() && (!durable || syncFile(path));
+    }
+
+    bool writeSnapshot(const std::string& path, const std::string& data) {
+        std::string tempPath = path + ".tmp";
+        std::ofstream file(tempPath.c_str());
+        if (!file.is_open()) {
+            return false;
+        }
+        file << data;
+        file.close();
+        if (file.fail() || (durable && !syncFile(tempPath)) || !replaceFile(tempPath, path)) {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    const char* name() const {
+        return durable ? "fstream+fsync" : "fstream";
+    }
+
+private:
+    bool durable;
+};
+
+#ifdef __linux__
+
+// Minimal io_uring driver over the raw syscalls, so no liburing is needed.
+// Not thread-safe: callers serialize writes (the server holds writerMutex).
+class IoUringPersistence : public PersistenceBackend {
+public:
+    IoUringPersistence() : ringFd(-1), appendFd(-1), broken(false), fallback(true), sqRing(0), cqRing(0),
+                           sqes(0), sqRingSize(0), cqRingSize(0), sqesSize(0) {}
+
+    ~IoUringPersistence() {
+        if (appendFd >= 0) close(appendFd);
+        if (sqes) munmap(sqes, sqesSize);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing) munmap(sqRing, sqRingSize);
+        if (ringFd >= 0) close(ringFd);
+    }
+
+    bool init(unsigned entries = QUEUE_DEPTH) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (ringFd < 0) {
+            return false;
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap && cqRingSize > sqRingSize) {
+            sqRingSize = cqRingSize;
+        }
+
+        sqRing = mmap(0, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            sqRing = 0;
+            return false;
+        }
+
+        if (singleMmap) {
+            cqRing = sqRing;
+        } else {
+            cqRing = mmap(0, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ringFd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) {
+                cqRing = 0;
+                return false;
+            }
+        }
+
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe*)mmap(0, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                   ringFd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            sqes = 0;
+            return false;
+        }
+
+        char* sq = (char*)sqRing;
+        sqHead = (unsigned*)(sq + params.sq_off.head);
+        sqTail = (unsigned*)(sq + params.sq_off.tail);
+        sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+        sqArray = (unsigned*)(sq + params.sq_off.array);
+        sqEntries = params.sq_entries;
+
+        char* cq = (char*)cqRing;
+        cqHead = (unsigned*)(cq + params.cq_off.head);
+        cqTail = (unsigned*)(cq + params.cq_off.tail);
+        cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+        return true;
+    }
+
+    // write and fsync are linked, so the fsync only runs once the write
+    // has fully landed and both go to the kernel in one submission
+    bool append(const std::string& path, const std::string& data) {
+        if (broken) {
+            return fallback.append(path, data);
+        }
+        // Another process may have replaced the file since it was opened
+        if (appendFd >= 0 && path == appendPath && !sameFile(appendFd, path)) {
+            close(appendFd);
+            appendFd = -1;
+        }
+        if (appendFd < 0 || path != appendPath) {
+            if (appendFd >= 0) close(appendFd);
+            appendFd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+            appendPath = path;
+            if (appendFd < 0) {
+                return false;
+            }
+        }
+
+        prepareWrite(appendFd, data.data(), (unsigned)data.size(), (unsigned long long)-1, IOSQE_IO_LINK);
+        prepareFsync(appendFd, 0);
+        return submitAndWait(2);
+    }
+
+    // Writes a temp file in batched chunks, fsyncs it, then renames it over
+    // the target so readers never see a half-written file
+    bool writeSnapshot(const std::string& path, const std::string& data) {
+        if (broken) {
+            return fallback.writeSnapshot(path, data);
+        }
+        std::string tempPath = path + ".tmp";
+        int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+
+        bool ok = true;
+        size_t offset = 0;
+        while (ok && offset < data.size()) {
+            unsigned batch = 0;
+            while (offset < data.size() && batch < sqEntries - 1) {
+                unsigned length = (unsigned)std::min((size_t)CHUNK_SIZE, data.size() - offset);
+                prepareWrite(fd, data.data() + offset, length, offset, 0);
+                offset += length;
+                batch++;
+            }
+            if (offset >= data.size()) {
+                // Drain: the fsync starts only after every write above completes
+                prepareFsync(fd, IOSQE_IO_DRAIN);
+                batch++;
+            }
+            ok = submitAndWait(batch);
+        }
+        if (ok && data.empty()) {
+            prepareFsync(fd, 0);
+            ok = submitAndWait(1);
+        }
+
+        close(fd);
+        if (!ok || !replaceFile(tempPath, path)) {
+            unlink(tempPath.c_str());
+            return false;
+        }
+
+        // The old inode is gone; reopen for the next append
+        if (appendFd >= 0 && path == appendPath) {
+            close(appendFd);
+            appendFd = -1;
+        }
+        return true;
+    }
+
+    const char* name() const {
+        return broken ? fallback.name() : "io_uring";
+    }
+
+private:
+    static const unsigned QUEUE_DEPTH = 64;
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    int ringFd;
+    int appendFd;
+    std::string appendPath;
+    // Set when the ring can no longer be trusted; later writes use fallback
+    bool broken;
+    StreamPersistence fallback;
+
+    void* sqRing;
+    void* cqRing;
+    io_uring_sqe* sqes;
+    size_t sqRingSize;
+    size_t cqRingSize;
+    size_t sqesSize;
+
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned sqEntries;
+
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+
+    static bool sameFile(int fd, const std::string& path) {
+        struct stat opened, named;
+        return fstat(fd, &opened) == 0 && stat(path.c_str(), &named) == 0 &&
+               opened.st_dev == named.st_dev && opened.st_ino == named.st_ino;
+    }
+
+    io_uring_sqe* nextSqe() {
+        unsigned tail = *sqTail;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        return sqe;
+    }
+
+    void prepareWrite(int fd, const char* buffer, unsigned length, unsigned long long offset, unsigned char flags) {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = (unsigned long long)(uintptr_t)buffer;
+        sqe->len = length;
+        sqe->off = offset;
+        sqe->flags = flags;
+        sqe->user_data = length;
+    }
+
+    void prepareFsync(int fd, unsigned char flags) {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = fd;
+        sqe->flags = flags;
+        sqe->user_data = 0;
+    }
+
+    // Submits the count entries queued and reaps their completions. A short
+    // write counts as a failure (it also cancels anything linked after it).
+    // Never returns with work left on the ring: entries the kernel did not
+    // take are withdrawn, and everything it did take is waited for, since
+    // it points into the caller's buffer and fd. If that wait itself fails
+    // the ring is abandoned for the stream backend.
+    bool submitAndWait(unsigned count) {
+        bool ok = true;
+        unsigned submitted = 0;
+        while (submitted < count) {
+            int ret = (int)syscall(__NR_io_uring_enter, ringFd, count - submitted, count - submitted,
+                                   IORING_ENTER_GETEVENTS, 0, 0);
+            if (ret < 0) {
+                if (errno == EINTR) continue;
+                ok = false;
+                break;
+            }
+            submitted += ret;
+        }
+        if (submitted < count) {
+            // We are the only producer, so resetting the tail drops them
+            __atomic_store_n(sqTail, __atomic_load_n(sqHead, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+        }
+
+        unsigned reaped = 0;
+        while (reaped < submitted) {
+            unsigned head = *cqHead;
+            if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                int ret = (int)syscall(__NR_io_uring_enter, ringFd, 0, submitted - reaped,
+                                       IORING_ENTER_GETEVENTS, 0, 0);
+                if (ret < 0 && errno != EINTR) {
+                    broken = true;
+                    return false;
+                }
+                continue;
+            }
+            io_uring_cqe* cqe = &cqes[head & *cqMask];
+            if (cqe->res < 0 || (unsigned long long)cqe->res != cqe->user_data) {
+                ok = false;
+            }
+            __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+            reaped++;
+        }
+        return ok;
+    }
+};
+
+#endif
+
+// Returns the io_uring backend when asked for and usable, else the stream one
+inline PersistenceBackend* createPersistence(bool useIoUring) {
+#ifdef __linux__
+    if (useIoUring) {
+        IoUringPersistence* ring = new IoUringPersistence();
+        if (ring->init()) {
+            return ring;
+        }
+        delete ring;
+    }
+#else
+    (void)useIoUring;
+#endif
+    return new StreamPersistence();
+}
+
+#endif
@@ -5,50 +5,471 @@
 #include <vector>
 #include <algorithm>
 #include <cstring>
+#include <cmath>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <atomic>
+#include <random>
+#include <shared_mutex>
+#include <climits>
+#include <filesystem>
+#include "student_store.h"
+
+#ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
 
 #pragma comment(lib, "ws2_32.lib")
+#else
+// POSIX sockets behind the Winsock names used below
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <csignal>
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+typedef int SOCKET;
+const int INVALID_SOCKET = -1;
+const int SOCKET_ERROR = -1;
+
+inline int closesocket(SOCKET socket) {
+    return close(socket);
+}
+
+inline int WSACleanup() {
+    return 0;
+}
+#endif
 
 using namespace std;
 
-// Student structure
-struct Student {
-    int id;
-    string name;
-    int age;
-    string course;
-    string email;
-    float gpa;
-    int marks;
+// Marks are 0-100; GPA (0.0-10.0) is bucketed to two decimals
+const int MARKS_BUCKETS = 101;
+const int GPA_BUCKETS = 1001;
+
+// Fenwick tree of per-bucket student counts. Answers "how many students are
+// at or below bucket b" and "which bucket holds the k-th student" in O(log B).
+struct FenwickTree {
+    vector<int> tree;
+    
+    FenwickTree(int buckets = 0) : tree(buckets + 1, 0) {}
+    
+    void add(int bucket, int delta) {
+        for (int i = bucket + 1; i < (int)tree.size(); i += i & -i) {
+            tree[i] += delta;
+        }
+    }
+    
+    // Number of students in buckets [0, bucket]
+    int countUpTo(int bucket) const {
+        int count = 0;
+        for (int i = min(bucket + 1, (int)tree.size() - 1); i > 0; i -= i & -i) {
+            count += tree[i];
+        }
+        return count;
+    }
+    
+    int total() const {
+        return countUpTo((int)tree.size() - 2);
+    }
+    
+    // Smallest bucket whose running count reaches k (k is 1-based)
+    int findKth(int k) const {
+        int pos = 0;
+        int step = 1;
+        while (step * 2 < (int)tree.size()) step *= 2;
+        for (; step > 0; step /= 2) {
+            if (pos + step < (int)tree.size() && tree[pos + step] < k) {
+                pos += step;
+                k -= tree[pos];
+            }
+        }
+        return pos;
+    }
+};
+
+// Order-statistic index for one metric: bucket counts for rank/percentile/
+// quantile, plus (bucket, -id) pairs so top-K is a walk from the high end.
+struct RankIndex {
+    FenwickTree counts;
+    set<pair<int, int> > ordered;
+    
+    RankIndex(int buckets = 0) : counts(buckets) {}
+};
+
+struct StudentIndex {
+    RankIndex byMarks;
+    RankIndex byGpa;
+    
+    StudentIndex() : byMarks(MARKS_BUCKETS), byGpa(GPA_BUCKETS) {}
+};
+
+typedef shared_ptr<const StudentIndex> IndexPtr;
+
+// One immutable version of the student table. Readers pin a version for the
+// whole request and keep seeing it even while writers publish newer ones.
+// Indexes are shared between versions until a write touches them.
+struct StudentSnapshot {
+    unsigned long long version;
+    vector<Student> students;
+    unordered_map<int, size_t> positionById;
+    IndexPtr overall;
+    map<string, IndexPtr> byCourse;
+};
+
+typedef shared_ptr<const StudentSnapshot> SnapshotPtr;
+
+// Requests are queued per class so heavy list calls can't starve cheap
+// by-id lookups or writes
+enum RouteClass {
+    ROUTE_LOOKUP,
+    ROUTE_LIST,
+    ROUTE_WRITE,
+    ROUTE_REPLICATION,
+    ROUTE_CLASS_COUNT
+};
+
+struct RouteLimits {
+    const char* name;
+    int workers;            // requests of this class handled concurrently
+    size_t queueCapacity;   // waiting requests before new ones are shed with 503
+    int defaultTimeoutMs;   // deadline when the client sends no X-Request-Timeout
+};
+
+struct PendingRequest {
+    SOCKET socket;
+    string client;          // peer address, for rate limiting
+    string request;
+    chrono::steady_clock::time_point acceptedAt;
+    chrono::steady_clock::time_point deadline;
+};
+
+struct RequestQueue {
+    mutex lock;
+    condition_variable ready;
+    deque<PendingRequest> pending;
+};
+
+// A frontend file held in memory. Files above STATIC_INLINE_LIMIT keep only
+// their metadata and are streamed from disk (sendfile on Linux).
+struct StaticAsset {
+    string contentType;
+    string cacheControl;
+    string etag;
+    string body;
+    string gzipBody;        // from a precompressed file.gz next to the file, if any
+    string diskPath;        // set for large files served from disk
+    size_t size;
+};
+
+// One committed write, as shipped to read replicas
+struct MutationEntry {
+    unsigned long long seq;
+    char op;                // 'A'dd, 'U'pdate, 'D'elete (only student.id is used)
+    Student student;
+};
+
+// Router table entry: ids [lo, hi] live on the server at host:port
+struct ShardRoute {
+    int lo;
+    int hi;
+    string host;
+    int port;
+    bool frozen;            // while splitting, writes to ids >= frozenLo are held back
+    int frozenLo;
+    multiset<int> writesInFlight;   // ids of relayed writes still running; INT_MAX for adds without one
+};
+
+// Per-client token bucket for rate limiting
+struct TokenBucket {
+    double tokens;
+    chrono::steady_clock::time_point lastRefill;
 };
 
 const string FILENAME = "students.txt";
+const int SHARD_TIMEOUT_MS = 10000;
+const int SHARD_TRANSFER_TIMEOUT_MS = 60000;
 const int PORT = 8080;
 
+const RouteLimits ROUTE_LIMITS[ROUTE_CLASS_COUNT] = {
+    { "lookup", 4, 64, 5000 },
+    { "list",   2, 8,  15000 },
+    { "write",  1, 32, 10000 },
+    // Followers long-poll the mutation log, so these hold a worker for a while
+    { "replication", 4, 16, 10000 }
+};
+
+// A router's writes only wait on shards, which serialize their own, so it
+// relays several at once instead of one shard stalling writes to all
+const int ROUTER_WRITE_WORKERS = 8;
+
+const size_t MUTATION_LOG_CAPACITY = 10000;
+const int REPLICATION_POLL_WAIT_MS = 1000;
+const int REPLICATION_MAX_WAIT_MS = 5000;
+const int FOLLOWER_TRUST_MS = 30000;
+
+// Accepted connections are read by a small pool, so a client that connects
+// and sends nothing ties up one reader for at most REQUEST_READ_TIMEOUT_MS
+// instead of stalling accept() for everyone
+const int READER_THREADS = 8;
+const size_t READER_QUEUE_CAPACITY = 256;
+const int REQUEST_READ_TIMEOUT_MS = 2000;
+
+const size_t STATIC_INLINE_LIMIT = 1024 * 1024;
+
+const double RATE_LIMIT_PER_SECOND = 20.0;
+const double RATE_LIMIT_BURST = 40.0;
+const size_t MAX_TRACKED_CLIENTS = 10000;
+
+// Current version of the resident store. Swapped atomically by writers;
+// superseded versions are freed when their last reader lets go.
+SnapshotPtr currentSnapshot;
+// Serializes writers only; readers never take it.
+mutex writerMutex;
+// Durable write path (fstream, or io_uring with --io-uring on Linux)
+PersistenceBackend* persistence = nullptr;
+// Shared with the console tool; the snapshots above are this process's
+// cache of it and are rebuilt when another process changes it
+StudentStore store;
+
+RequestQueue requestQueues[ROUTE_CLASS_COUNT];
+RequestQueue connectionQueue;
+// Shared by the reader threads; the critical section is a map lookup and
+// a little arithmetic, so one lock is enough
+mutex bucketMutex;
+map<string, TokenBucket> clientBuckets;
+// Frontend files by lowercased URL path; filled before workers start, read-only after
+map<string, StaticAsset> assetCache;
+int port = PORT;
+
+// Primary side: recent writes for followers. Entries cover seqs
+// (logBaseSeq, lastSeq]; a follower further behind gets a full snapshot.
+// Lock order is writerMutex, then logMutex.
+mutex logMutex;
+condition_variable logChanged;
+deque<MutationEntry> mutationLog;
+unsigned long long logBaseSeq = 0;
+unsigned long long lastSeq = 0;
+// Random per primary run: sequence numbers from another run mean nothing
+unsigned long long replicationEpoch = 0;
+// Addresses that polled the log lately, i.e. followers. Writes they relay
+// are rate-limited per X-Forwarded-For client, not as one client.
+mutex followerMutex;
+map<string, long long> followerLastPollMs;
+
+// Follower side (--follow host:port): read-only replica of a primary
+bool followerMode = false;
+string primaryHost;
+int primaryPort = 0;
+atomic<unsigned long long> appliedSeq(0);
+atomic<unsigned long long> followedEpoch(0);
+atomic<long long> lastCaughtUpMs(-1);
+atomic<long long> pollStartedMs(-1);
+atomic<bool> primaryReachable(false);
+
+// Shard side (--shard-range lo-hi): the ids this instance owns. The
+// /api/shard/ endpoints that move and delete data only exist in this mode.
+string dataFile = FILENAME;
+bool shardMode = false;
+atomic<int> shardLo(1);
+atomic<int> shardHi(INT_MAX);
+
+// Router side (--router --shard lo-hi=host:port ...). Fan-out reads hold
+// splitLock shared, so they never see a range on two shards mid-split.
+bool routerMode = false;
+mutex routeMutex;
+condition_variable routeChanged;
+vector<ShardRoute> shardRoutes;     // sorted by lo, non-overlapping
+shared_timed_mutex splitLock;
+// One split at a time, run on its own thread; its outcome is kept for
+// GET /api/shard/split (guarded by routeMutex)
+atomic<bool> splitRunning(false);
+string lastSplitResult;
+
+// Servers behind a router see every client as the router's address
+bool rateLimitEnabled = true;
+
 // Function prototypes
-vector<Student> loadStudents();
-void saveStudents(const vector<Student>& students);
-int generateNewId();
+SnapshotPtr acquireSnapshot();
+void publishSnapshot(vector<Student> students, unsigned long long version,
+                     const Student* removed = nullptr, const Student* added = nullptr);
+void refreshSnapshot();
+void syncSnapshot(bool wait = true);
+void publishWrite(const Student* removed, const Student* added);
+int marksBucket(const Student& student);
+int gpaBucket(const Student& student);
+void indexStudent(StudentIndex& index, const Student& student, int delta);
 string handleRequest(const string& request);
+RouteClass classifyRequest(const string& request);
+string getHeader(const string& request, const string& name);
+bool takeToken(const string& client, int& retryAfterSeconds);
+bool admitRequest(RouteClass routeClass, PendingRequest pending);
+void workerLoop(RouteClass routeClass);
+void readerLoop();
+void setSocketTimeouts(SOCKET socket, int timeoutMs);
+void sendHttpResponse(SOCKET socket, int statusCode, const string& body, const string& extraHeaders = "",
+                      const string& contentType = "application/json");
+bool sendAll(SOCKET socket, const char* data, size_t length);
+size_t loadStaticAssets(const string& frontendDir);
+void serveStaticAsset(SOCKET socket, const string& request);
+string contentTypeFor(const string& extension);
+string computeETag(const string& data);
+string getQueryParam(const string& query, const string& name);
+string urlDecode(const string& text);
+string studentToJSON(const Student& student);
 string addStudentAPI(const string& data);
 string getAllStudentsAPI();
 string searchStudentAPI(int id);
+string topStudentsAPI(const string& query);
+string studentRankAPI(int id, const string& query);
+string quantileAPI(const string& query);
+string rankResponse(const Student& student, const string& by, const FenwickTree& counts);
+string quantileResponse(double q, const string& by, const FenwickTree& counts);
 string updateStudentAPI(const string& data);
 string deleteStudentAPI(int id);
 string createJSONResponse(const string& status, const string& message, const string& data = "");
+void appendMutation(char op, const Student& student);
+void resetMutationLog();
+string replicationLogAPI(const string& query);
+string replicationStatusAPI();
+void followPrimary();
+bool applyReplicationBatch(const string& body, unsigned long long from);
+long long replicationLagMs();
+void forwardToPrimary(SOCKET socket, const string& request, const string& client);
+string rateLimitKey(const PendingRequest& pending, RouteClass routeClass);
+long long steadyNowMs();
+string httpExchange(const string& host, int port, const string& request, int timeoutMs);
+int parseHttpResponse(const string& response, string& body);
+bool parseRange(const string& text, int& lo, int& hi);
+int nextShardId(const StudentSnapshot& snapshot);
+string shardHistogramAPI(const string& query);
+string shardExportAPI(const string& query);
+string shardImportAPI(const string& data);
+string shardDropAPI(const string& data);
+string shardInfoAPI(const string& query);
+void routeRequest(SOCKET socket, const string& request);
+void forwardToShard(SOCKET socket, const string& request, int id, bool isWrite);
+bool fanOut(const string& pathAndQuery, vector<string>& bodies);
+string shardGet(const ShardRoute& route, const string& pathAndQuery, int timeoutMs = SHARD_TIMEOUT_MS);
+string shardPost(const ShardRoute& route, const string& path, const string& body, int timeoutMs);
+bool mergedHistogram(const string& by, const string& course, FenwickTree& counts);
+string mergeTopStudents(const vector<string>& bodies, const string& by, int k);
+string splitShardAPI(const string& data);
+string runSplit(int at, ShardRoute added);
+string splitStatusAPI();
+string shardMapAPI();
+string jsonDataArray(const string& body);
+vector<string> splitJSONObjects(const string& array);
+Student studentFromJSON(const string& object);
+int jsonInt(const string& json, const string& field, int fallback = 0);
+string jsonString(const string& json, const string& field);
+string urlEncode(const string& text);
 
-int main() {
-    WSADATA wsaData;
+int main(int argc, char* argv[]) {
     SOCKET serverSocket, clientSocket;
     struct sockaddr_in serverAddr, clientAddr;
-    int clientAddrLen = sizeof(clientAddr);
+    socklen_t clientAddrLen = sizeof(clientAddr);
+    bool useIoUring = false;
+    string frontendDir = "";
     
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--io-uring") {
+            useIoUring = true;
+        } else if (string(argv[i]) == "--frontend" && i + 1 < argc) {
+            frontendDir = argv[++i];
+        } else if (string(argv[i]) == "--port" && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (string(argv[i]) == "--follow" && i + 1 < argc) {
+            // host:port of the primary to replicate from
+            string primary = argv[++i];
+            size_t colon = primary.rfind(':');
+            followerMode = true;
+            primaryHost = primary.substr(0, colon);
+            primaryPort = (colon == string::npos) ? PORT : atoi(primary.substr(colon + 1).c_str());
+        } else if (string(argv[i]) == "--data" && i + 1 < argc) {
+            dataFile = argv[++i];
+        } else if (string(argv[i]) == "--shard-range" && i + 1 < argc) {
+            int lo, hi;
+            if (!parseRange(argv[++i], lo, hi)) {
+                cerr << "Bad --shard-range, expected lo-hi\n";
+                return 1;
+            }
+            shardMode = true;
+            shardLo = lo;
+            shardHi = hi;
+        } else if (string(argv[i]) == "--no-rate-limit") {
+            rateLimitEnabled = false;
+        } else if (string(argv[i]) == "--router") {
+            routerMode = true;
+        } else if (string(argv[i]) == "--shard" && i + 1 < argc) {
+            // lo-hi=host:port
+            string spec = argv[++i];
+            size_t equals = spec.find('=');
+            size_t colon = spec.rfind(':');
+            ShardRoute route;
+            if (equals == string::npos || colon == string::npos || colon < equals ||
+                !parseRange(spec.substr(0, equals), route.lo, route.hi)) {
+                cerr << "Bad --shard, expected lo-hi=host:port\n";
+                return 1;
+            }
+            route.host = spec.substr(equals + 1, colon - equals - 1);
+            route.port = atoi(spec.substr(colon + 1).c_str());
+            route.frozen = false;
+            route.frozenLo = INT_MAX;
+            shardRoutes.push_back(route);
+        }
+    }
+    
+    if (shardMode && (routerMode || followerMode)) {
+        cerr << "--shard-range cannot be combined with --router or --follow\n";
+        return 1;
+    }
+    if (routerMode) {
+        sort(shardRoutes.begin(), shardRoutes.end(),
+             [](const ShardRoute& a, const ShardRoute& b) { return a.lo < b.lo; });
+        for (size_t i = 1; i < shardRoutes.size(); i++) {
+            if (shardRoutes[i].lo <= shardRoutes[i - 1].hi) {
+                cerr << "Shard ranges overlap\n";
+                return 1;
+            }
+        }
+        if (shardRoutes.empty()) {
+            cerr << "--router needs at least one --shard\n";
+            return 1;
+        }
+    }
+    persistence = createPersistence(useIoUring);
+    
+    // Serve the UI from the same origin as the API; works when started from
+    // the project root or from backend/
+    if (frontendDir.empty()) {
+        frontendDir = filesystem::is_directory("frontend") ? "frontend" : "../frontend";
+    }
+    size_t assetCount = loadStaticAssets(frontendDir);
+    
+#ifdef _WIN32
     // Initialize Winsock
+    WSADATA wsaData;
     if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
         cerr << "WSAStartup failed\n";
         return 1;
     }
+#else
+    // A client hanging up mid-response must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+#endif
     
     // Create socket
     serverSocket = socket(AF_INET, SOCK_STREAM, 0);
@@ -58,10 +479,16 @@ int main() {
         return 1;
     }
     
+#ifndef _WIN32
+    // Allow a restarted server to rebind while old connections sit in TIME_WAIT
+    int reuse = 1;
+    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+    
     // Configure server address
     serverAddr.sin_family = AF_INET;
     serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(PORT);
+    serverAddr.sin_port = htons(port);
     
     // Bind socket
     if (bind(serverSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
@@ -72,51 +499,109 @@ int main() {
     }
     
     // Listen for connections
-    if (listen(serverSocket, 5) == SOCKET_ERROR) {
+    if (listen(serverSocket, SOMAXCONN) == SOCKET_ERROR) {
         cerr << "Listen failed\n";
         closesocket(serverSocket);
         WSACleanup();
         return 1;
     }
     
+    replicationEpoch = ((unsigned long long)random_device()() << 32) ^ random_device()() ^
+                       (unsigned long long)chrono::system_clock::now().time_since_epoch().count();
+    
+    if (routerMode) {
+        // Holds no data; everything under /api/ goes to the shards
+    } else if (followerMode) {
+        // Start empty and fill from the primary's log; the data file is untouched
+        publishSnapshot(vector<Student>(), 0);
+        thread(followPrimary).detach();
+    } else {
+        // Attach to the shared store; requests are served from memory afterwards
+        if (!store.open(dataFile, persistence)) {
+            cerr << "Unable to open the shared student store: " << store.error() << "\n";
+            closesocket(serverSocket);
+            WSACleanup();
+            return 1;
+        }
+        syncSnapshot();
+        
+        // Records outside the range would be counted twice by the router's
+        // fan-out while by-id requests went to another shard
+        if (shardMode) {
+            SnapshotPtr snapshot = acquireSnapshot();
+            size_t outside = count_if(snapshot->students.begin(), snapshot->students.end(),
+                                      [](const Student& s) { return s.id < shardLo || s.id > shardHi; });
+            if (outside > 0) {
+                cerr << dataFile << " holds " << outside << " records outside --shard-range " << shardLo << "-"
+                     << shardHi << "; move them to their shard first\n";
+                closesocket(serverSocket);
+                WSACleanup();
+                return 1;
+            }
+        }
+    }
+    
+    // Start the reader pool and the per-class worker pools
+    for (int r = 0; r < READER_THREADS; r++) {
+        thread(readerLoop).detach();
+    }
+    for (int c = 0; c < ROUTE_CLASS_COUNT; c++) {
+        int workers = (routerMode && c == ROUTE_WRITE) ? ROUTER_WRITE_WORKERS : ROUTE_LIMITS[c].workers;
+        for (int w = 0; w < workers; w++) {
+            thread(workerLoop, (RouteClass)c).detach();
+        }
+    }
+    
     cout << "========================================\n";
     cout << "  SRMS Backend Server Running\n";
-    cout << "  Port: " << PORT << "\n";
+    cout << "  Port: " << port << "\n";
+    if (routerMode) {
+        cout << "  Role: router\n";
+        for (const auto& route : shardRoutes) {
+            cout << "    ids " << route.lo << "-" << route.hi << " -> " << route.host << ":" << route.port << "\n";
+        }
+    } else if (followerMode) {
+        cout << "  Role: read replica of " << primaryHost << ":" << primaryPort << "\n";
+    } else {
+        cout << "  Data: " << dataFile << " (" << persistence->name() << ")\n";
+        if (shardMode) {
+            cout << "  Shard: ids " << shardLo << "-" << shardHi << "\n";
+        }
+    }
+    cout << "  Frontend: " << assetCount << " files from " << frontendDir << "\n";
     cout << "========================================\n\n";
     cout << "Waiting for connections...\n\n";
     
-    // Accept and handle connections
+    // Accept connections and hand them to the reader pool; nothing here
+    // waits on a client
     while (true) {
         clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientAddrLen);
         if (clientSocket == INVALID_SOCKET) {
             cerr << "Accept failed\n";
             continue;
         }
+        setSocketTimeouts(clientSocket, REQUEST_READ_TIMEOUT_MS);
         
-        char buffer[4096] = {0};
-        int bytesReceived = recv(clientSocket, buffer, sizeof(buffer), 0);
+        PendingRequest pending;
+        pending.socket = clientSocket;
+        pending.client = inet_ntoa(clientAddr.sin_addr);
+        pending.acceptedAt = chrono::steady_clock::now();
         
-        if (bytesReceived > 0) {
-            string request(buffer);
-            cout << "Received request:\n" << request.substr(0, 200) << "...\n\n";
-            
-            string response = handleRequest(request);
-            
-            // Send HTTP response
-            string httpResponse = "HTTP/1.1 200 OK\r\n";
-            httpResponse += "Content-Type: application/json\r\n";
-            httpResponse += "Access-Control-Allow-Origin: *\r\n";
-            httpResponse += "Access-Control-Allow-Methods: GET, POST, PUT, DELETE, OPTIONS\r\n";
-            httpResponse += "Access-Control-Allow-Headers: Content-Type\r\n";
-            httpResponse += "Content-Length: " + to_string(response.length()) + "\r\n";
-            httpResponse += "\r\n";
-            httpResponse += response;
-            
-            send(clientSocket, httpResponse.c_str(), httpResponse.length(), 0);
-            cout << "Response sent\n\n";
+        bool queued = false;
+        {
+            lock_guard<mutex> lock(connectionQueue.lock);
+            if (connectionQueue.pending.size() < READER_QUEUE_CAPACITY) {
+                connectionQueue.pending.push_back(pending);
+                queued = true;
+            }
+        }
+        if (queued) {
+            connectionQueue.ready.notify_one();
+        } else {
+            sendHttpResponse(clientSocket, 503, createJSONResponse("error", "Server busy, please retry"),
+                             "Retry-After: 1\r\n");
+            closesocket(clientSocket);
         }
-        
-        closesocket(clientSocket);
     }
     
     closesocket(serverSocket);
@@ -124,12 +609,430 @@ int main() {
     return 0;
 }
 
+// Reads one request per connection, then applies rate limiting and
+// admission control and queues it for its route class
+void readerLoop() {
+    while (true) {
+        PendingRequest pending;
+        {
+            unique_lock<mutex> lock(connectionQueue.lock);
+            connectionQueue.ready.wait(lock, [] { return !connectionQueue.pending.empty(); });
+            pending = connectionQueue.pending.front();
+            connectionQueue.pending.pop_front();
+        }
+        
+        // Times out after REQUEST_READ_TIMEOUT_MS for clients that send nothing
+        char buffer[4096];
+        int bytesReceived = recv(pending.socket, buffer, sizeof(buffer), 0);
+        
+        if (bytesReceived <= 0) {
+            closesocket(pending.socket);
+            continue;
+        }
+        
+        pending.request = string(buffer, bytesReceived);
+        cout << "Received request:\n" << pending.request.substr(0, 200) << "...\n\n";
+        
+        RouteClass routeClass = classifyRequest(pending.request);
+        
+        // Followers poll continuously; rate limiting them would only add lag
+        int retryAfter = 0;
+        string rateKey = rateLimitKey(pending, routeClass);
+        if (rateLimitEnabled && routeClass != ROUTE_REPLICATION && !takeToken(rateKey, retryAfter)) {
+            sendHttpResponse(pending.socket, 429, createJSONResponse("error", "Too many requests"),
+                             "Retry-After: " + to_string(retryAfter) + "\r\n");
+            closesocket(pending.socket);
+            continue;
+        }
+        
+        // The client's own timeout bounds how long the request may wait,
+        // counted from accept so time spent waiting for a reader counts too
+        int timeoutMs = ROUTE_LIMITS[routeClass].defaultTimeoutMs;
+        string timeoutHeader = getHeader(pending.request, "X-Request-Timeout");
+        if (!timeoutHeader.empty() && atoi(timeoutHeader.c_str()) > 0) {
+            timeoutMs = atoi(timeoutHeader.c_str());
+        }
+        pending.deadline = pending.acceptedAt + chrono::milliseconds(timeoutMs);
+        
+        if (!admitRequest(routeClass, pending)) {
+            sendHttpResponse(pending.socket, 503, createJSONResponse("error", "Server busy, please retry"),
+                             "Retry-After: 1\r\n");
+            closesocket(pending.socket);
+        }
+    }
+}
+
+// Bounds blocking recv/send on a socket
+void setSocketTimeouts(SOCKET socket, int timeoutMs) {
+#ifdef _WIN32
+    DWORD timeout = timeoutMs;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+#endif
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+// Bounded queue: refuses instead of letting the backlog grow without limit
+bool admitRequest(RouteClass routeClass, PendingRequest pending) {
+    RequestQueue& queue = requestQueues[routeClass];
+    {
+        lock_guard<mutex> lock(queue.lock);
+        if (queue.pending.size() >= ROUTE_LIMITS[routeClass].queueCapacity) {
+            return false;
+        }
+        queue.pending.push_back(pending);
+    }
+    queue.ready.notify_one();
+    return true;
+}
+
+void workerLoop(RouteClass routeClass) {
+    RequestQueue& queue = requestQueues[routeClass];
+    
+    while (true) {
+        PendingRequest pending;
+        {
+            unique_lock<mutex> lock(queue.lock);
+            queue.ready.wait(lock, [&queue] { return !queue.pending.empty(); });
+            pending = queue.pending.front();
+            queue.pending.pop_front();
+        }
+        
+        // The client has already given up; don't spend work on it
+        if (chrono::steady_clock::now() > pending.deadline) {
+            sendHttpResponse(pending.socket, 503, createJSONResponse("error", "Request expired in queue"),
+                             "Retry-After: 1\r\n");
+            closesocket(pending.socket);
+            cout << "Dropped expired " << ROUTE_LIMITS[routeClass].name << " request\n\n";
+            continue;
+        }
+        
+        istringstream requestLine(pending.request);
+        string method, path;
+        requestLine >> method >> path;
+        
+        if ((method == "GET" || method == "HEAD") && path.find("/api/") != 0) {
+            serveStaticAsset(pending.socket, pending.request);
+        } else if (routerMode) {
+            routeRequest(pending.socket, pending.request);
+        } else if (shardMode && (path.find("/api/shard/histogram") == 0 || path.find("/api/shard/export") == 0)) {
+            size_t queryPos = path.find('?');
+            string query = (queryPos == string::npos) ? "" : path.substr(queryPos + 1);
+            string body = (path.find("/api/shard/histogram") == 0) ? shardHistogramAPI(query) : shardExportAPI(query);
+            sendHttpResponse(pending.socket, 200, body, "", "text/plain");
+        } else if (path.find("/api/replication/log") == 0) {
+            size_t queryPos = path.find('?');
+            string query = (queryPos == string::npos) ? "" : path.substr(queryPos + 1);
+            sendHttpResponse(pending.socket, 200, replicationLogAPI(query), "", "text/plain");
+        } else if (followerMode && (method == "POST" || method == "PUT" || method == "DELETE")) {
+            forwardToPrimary(pending.socket, pending.request, pending.client);
+        } else {
+            string response = handleRequest(pending.request);
+            string headers = "";
+            if (followerMode) {
+                headers = "X-Replication-Lag-Ms: " + to_string(replicationLagMs()) + "\r\n";
+            }
+            sendHttpResponse(pending.socket, 200, response, headers);
+        }
+        closesocket(pending.socket);
+        cout << "Response sent\n\n";
+    }
+}
+
+RouteClass classifyRequest(const string& request) {
+    istringstream stream(request);
+    string method, path;
+    stream >> method >> path;
+    
+    if (path.find("/api/replication/log") == 0) {
+        return ROUTE_REPLICATION;
+    }
+    if (method == "POST" || method == "PUT" || method == "DELETE") {
+        return ROUTE_WRITE;
+    }
+    if (path == "/api/students" || path.find("/api/students?") == 0) {
+        return ROUTE_LIST;
+    }
+    return ROUTE_LOOKUP;
+}
+
+// Whose bucket a request is charged to. Log polls mark their sender as a
+// follower for FOLLOWER_TRUST_MS; a follower's relayed writes are charged
+// to the client it names in X-Forwarded-For. The log itself hands every
+// record to whoever asks, so this trusts no one the log doesn't already.
+string rateLimitKey(const PendingRequest& pending, RouteClass routeClass) {
+    long long now = steadyNowMs();
+    lock_guard<mutex> lock(followerMutex);
+    if (routeClass == ROUTE_REPLICATION) {
+        if (followerLastPollMs.size() > MAX_TRACKED_CLIENTS) {
+            followerLastPollMs.clear();
+        }
+        followerLastPollMs[pending.client] = now;
+        return pending.client;
+    }
+    
+    string forwarded = getHeader(pending.request, "X-Forwarded-For");
+    auto it = followerLastPollMs.find(pending.client);
+    if (!forwarded.empty() && it != followerLastPollMs.end() && now - it->second <= FOLLOWER_TRUST_MS) {
+        return forwarded;
+    }
+    return pending.client;
+}
+
+// Returns false when the client is over its rate; retryAfterSeconds is then
+// how long until its next token
+bool takeToken(const string& client, int& retryAfterSeconds) {
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    lock_guard<mutex> lock(bucketMutex);
+    
+    if (clientBuckets.size() > MAX_TRACKED_CLIENTS) {
+        clientBuckets.clear();
+    }
+    
+    auto it = clientBuckets.find(client);
+    if (it == clientBuckets.end()) {
+        TokenBucket bucket;
+        bucket.tokens = RATE_LIMIT_BURST;
+        bucket.lastRefill = now;
+        it = clientBuckets.insert(make_pair(client, bucket)).first;
+    }
+    
+    TokenBucket& bucket = it->second;
+    double elapsed = chrono::duration<double>(now - bucket.lastRefill).count();
+    bucket.tokens = min(RATE_LIMIT_BURST, bucket.tokens + elapsed * RATE_LIMIT_PER_SECOND);
+    bucket.lastRefill = now;
+    
+    if (bucket.tokens < 1.0) {
+        retryAfterSeconds = (int)ceil((1.0 - bucket.tokens) / RATE_LIMIT_PER_SECOND);
+        return false;
+    }
+    
+    bucket.tokens -= 1.0;
+    return true;
+}
+
+string getHeader(const string& request, const string& name) {
+    string needle = "\r\n" + name + ":";
+    size_t pos = request.find(needle);
+    if (pos == string::npos) {
+        return "";
+    }
+    size_t start = pos + needle.size();
+    size_t end = request.find("\r\n", start);
+    string value = request.substr(start, end - start);
+    value.erase(0, value.find_first_not_of(' '));
+    return value;
+}
+
+void sendHttpResponse(SOCKET socket, int statusCode, const string& body, const string& extraHeaders,
+                      const string& contentType) {
+    string statusText = "OK";
+    if (statusCode == 404) statusText = "Not Found";
+    else if (statusCode == 429) statusText = "Too Many Requests";
+    else if (statusCode == 503) statusText = "Service Unavailable";
+    
+    string httpResponse = "HTTP/1.1 " + to_string(statusCode) + " " + statusText + "\r\n";
+    httpResponse += "Content-Type: " + contentType + "\r\n";
+    httpResponse += "Access-Control-Allow-Origin: *\r\n";
+    httpResponse += "Access-Control-Allow-Methods: GET, POST, PUT, DELETE, OPTIONS\r\n";
+    httpResponse += "Access-Control-Allow-Headers: Content-Type, X-Request-Timeout\r\n";
+    httpResponse += extraHeaders;
+    httpResponse += "Content-Length: " + to_string(body.length()) + "\r\n";
+    httpResponse += "\r\n";
+    httpResponse += body;
+    
+    sendAll(socket, httpResponse.c_str(), httpResponse.length());
+}
+
+bool sendAll(SOCKET socket, const char* data, size_t length) {
+    while (length > 0) {
+        int sent = send(socket, data, (int)min(length, (size_t)1 << 20), 0);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+// Reads every file under frontendDir into assetCache. A file.gz next to a
+// file is kept as its gzip variant instead of being served on its own.
+size_t loadStaticAssets(const string& frontendDir) {
+    error_code ec;
+    filesystem::recursive_directory_iterator it(frontendDir, ec), end;
+    if (ec) {
+        cerr << "Frontend directory not found: " << frontendDir << "\n";
+        return 0;
+    }
+    
+    for (; it != end; it.increment(ec)) {
+        if (ec || !it->is_regular_file()) continue;
+        
+        filesystem::path filePath = it->path();
+        string extension = filePath.extension().string();
+        if (extension == ".gz") continue;
+        
+        // URLs are matched case-insensitively: the pages link js/app.js
+        // while the directory on disk is Js/
+        string urlPath = "/" + filesystem::relative(filePath, frontendDir).generic_string();
+        transform(urlPath.begin(), urlPath.end(), urlPath.begin(), ::tolower);
+        transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        
+        StaticAsset asset;
+        asset.contentType = contentTypeFor(extension);
+        // Pages must revalidate so new deploys show up; their assets can be cached longer
+        asset.cacheControl = (extension == ".html") ? "no-cache" : "public, max-age=86400";
+        asset.size = (size_t)filesystem::file_size(filePath);
+        
+        ifstream file(filePath, ios::binary);
+        string content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        asset.etag = computeETag(content);
+        
+        if (asset.size > STATIC_INLINE_LIMIT) {
+            asset.diskPath = filePath.string();
+        } else {
+            asset.body = content;
+            
+            ifstream gzipFile(filePath.string() + ".gz", ios::binary);
+            if (gzipFile.is_open()) {
+                asset.gzipBody.assign((istreambuf_iterator<char>(gzipFile)), istreambuf_iterator<char>());
+            }
+        }
+        
+        assetCache[urlPath] = asset;
+    }
+    
+    return assetCache.size();
+}
+
+void serveStaticAsset(SOCKET socket, const string& request) {
+    istringstream stream(request);
+    string method, path;
+    stream >> method >> path;
+    
+    path = urlDecode(path.substr(0, path.find('?')));
+    if (!path.empty() && path[path.size() - 1] == '/') {
+        path += "index.html";
+    }
+    transform(path.begin(), path.end(), path.begin(), ::tolower);
+    
+    auto it = assetCache.find(path);
+    if (it == assetCache.end()) {
+        sendHttpResponse(socket, 404, createJSONResponse("error", "Not found"));
+        return;
+    }
+    const StaticAsset& asset = it->second;
+    
+    bool useGzip = !asset.gzipBody.empty() && getHeader(request, "Accept-Encoding").find("gzip") != string::npos;
+    string etag = useGzip ? asset.etag.substr(0, asset.etag.size() - 1) + "-gz\"" : asset.etag;
+    
+    string headers = "Cache-Control: " + asset.cacheControl + "\r\n";
+    headers += "ETag: " + etag + "\r\n";
+    headers += "Vary: Accept-Encoding\r\n";
+    
+    if (getHeader(request, "If-None-Match") == etag) {
+        string httpResponse = "HTTP/1.1 304 Not Modified\r\n" + headers + "\r\n";
+        sendAll(socket, httpResponse.c_str(), httpResponse.length());
+        return;
+    }
+    
+    const string& body = useGzip ? asset.gzipBody : asset.body;
+    size_t length = asset.diskPath.empty() ? body.size() : asset.size;
+    
+    string httpResponse = "HTTP/1.1 200 OK\r\n";
+    httpResponse += "Content-Type: " + asset.contentType + "\r\n";
+    if (useGzip) {
+        httpResponse += "Content-Encoding: gzip\r\n";
+    }
+    httpResponse += headers;
+    httpResponse += "Content-Length: " + to_string(length) + "\r\n";
+    httpResponse += "\r\n";
+    
+    if (method == "HEAD") {
+        sendAll(socket, httpResponse.c_str(), httpResponse.length());
+        return;
+    }
+    
+    if (asset.diskPath.empty()) {
+        httpResponse += body;
+        sendAll(socket, httpResponse.c_str(), httpResponse.length());
+        return;
+    }
+    
+    if (!sendAll(socket, httpResponse.c_str(), httpResponse.length())) {
+        return;
+    }
+    
+#ifdef __linux__
+    // Large files go straight from the page cache to the socket
+    int fd = open(asset.diskPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    off_t offset = 0;
+    while ((size_t)offset < asset.size) {
+        if (sendfile(socket, fd, &offset, asset.size - offset) <= 0) {
+            break;
+        }
+    }
+    close(fd);
+#else
+    ifstream file(asset.diskPath, ios::binary);
+    char buffer[64 * 1024];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        if (!sendAll(socket, buffer, (size_t)file.gcount())) {
+            break;
+        }
+    }
+#endif
+}
+
+string contentTypeFor(const string& extension) {
+    if (extension == ".html") return "text/html; charset=utf-8";
+    if (extension == ".css") return "text/css; charset=utf-8";
+    if (extension == ".js") return "application/javascript; charset=utf-8";
+    if (extension == ".json") return "application/json";
+    if (extension == ".png") return "image/png";
+    if (extension == ".jpg" || extension == ".jpeg") return "image/jpeg";
+    if (extension == ".svg") return "image/svg+xml";
+    if (extension == ".ico") return "image/x-icon";
+    return "application/octet-stream";
+}
+
+// Quoted 64-bit FNV-1a hash of the content
+string computeETag(const string& data) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "\"%016llx\"", hash);
+    return buffer;
+}
+
 string handleRequest(const string& request) {
     // Parse HTTP method and path
     istringstream stream(request);
     string method, path;
     stream >> method >> path;
     
+    // Split off the query string
+    string query = "";
+    size_t queryPos = path.find('?');
+    if (queryPos != string::npos) {
+        query = path.substr(queryPos + 1);
+        path = path.substr(0, queryPos);
+    }
+    
+    // Pick up writes made by other processes (e.g. the console tool)
+    refreshSnapshot();
+    
     // Handle OPTIONS for CORS
     if (method == "OPTIONS") {
         return "{}";
@@ -143,10 +1046,26 @@ string handleRequest(const string& request) {
     }
     
     // Route requests
-    if (path == "/api/students" && method == "GET") {
+    if (path == "/api/replication/status" && method == "GET") {
+        return replicationStatusAPI();
+    } else if (shardMode && path == "/api/shard/info" && method == "GET") {
+        return shardInfoAPI(query);
+    } else if (shardMode && path == "/api/shard/import" && method == "POST") {
+        return shardImportAPI(body);
+    } else if (shardMode && path == "/api/shard/drop" && method == "POST") {
+        return shardDropAPI(body);
+    } else if (path == "/api/students" && method == "GET") {
         return getAllStudentsAPI();
     } else if (path == "/api/students" && method == "POST") {
         return addStudentAPI(body);
+    } else if (path == "/api/students/top" && method == "GET") {
+        return topStudentsAPI(query);
+    } else if (path == "/api/students/quantile" && method == "GET") {
+        return quantileAPI(query);
+    } else if (path.find("/api/students/") == 0 && path.size() > 19 &&
+               path.compare(path.size() - 5, 5, "/rank") == 0 && method == "GET") {
+        int id = stoi(path.substr(14));
+        return studentRankAPI(id, query);
     } else if (path.find("/api/students/") == 0 && method == "GET") {
         int id = stoi(path.substr(14));
         return searchStudentAPI(id);
@@ -163,11 +1082,12 @@ string handleRequest(const string& request) {
 string addStudentAPI(const string& data) {
     // Parse JSON data (simple parsing)
     Student student;
+    student.id = 0;
     
     // Extract fields from JSON
     size_t pos;
     
-    // Check if custom ID is provided
+    // Check if custom ID is provided (0 means auto-generate below)
     pos = data.find("\"id\":");
     if (pos != string::npos) {
         size_t start = pos + 5;
@@ -177,11 +1097,7 @@ string addStudentAPI(const string& data) {
         idStr.erase(remove_if(idStr.begin(), idStr.end(), ::isspace), idStr.end());
         if (!idStr.empty() && idStr != "null" && idStr != "0") {
             student.id = stoi(idStr);
-        } else {
-            student.id = generateNewId();
         }
-    } else {
-        student.id = generateNewId();
     }
     
     pos = data.find("\"name\":\"");
@@ -228,34 +1144,38 @@ string addStudentAPI(const string& data) {
         student.marks = 0;
     }
     
-    // Save to file
-    ofstream file(FILENAME, ios::app);
-    if (file.is_open()) {
-        file << student.id << "|" << student.name << "|" << student.age << "|" 
-             << student.course << "|" << student.email << "|" << student.gpa << "|" << student.marks << "\n";
-        file.close();
+    // An id of 0 is assigned by the store, or below from this shard's range
+    lock_guard<mutex> lock(writerMutex);
+    syncSnapshot();
+    
+    if (shardMode && student.id != 0 && (student.id < shardLo || student.id > shardHi)) {
+        return createJSONResponse("error", "ID belongs to another shard");
+    }
+    if (shardMode && student.id == 0) {
+        student.id = nextShardId(*acquireSnapshot());
+        if (student.id == 0) {
+            return createJSONResponse("error", "Shard ID range is full");
+        }
+    }
+    
+    if (store.add(student)) {
+        publishWrite(nullptr, &student);
         
         string studentData = "{\"id\":" + to_string(student.id) + ",\"name\":\"" + student.name + "\"}";
         return createJSONResponse("success", "Student added successfully", studentData);
     }
     
-    return createJSONResponse("error", "Failed to add student");
+    return createJSONResponse("error", "Failed to add student: " + store.error());
 }
 
 string getAllStudentsAPI() {
-    vector<Student> students = loadStudents();
+    // Pin one version so the whole list is consistent even if writes land meanwhile
+    SnapshotPtr snapshot = acquireSnapshot();
+    const vector<Student>& students = snapshot->students;
     
     string jsonArray = "[";
     for (size_t i = 0; i < students.size(); i++) {
-        jsonArray += "{";
-        jsonArray += "\"id\":" + to_string(students[i].id) + ",";
-        jsonArray += "\"name\":\"" + students[i].name + "\",";
-        jsonArray += "\"age\":" + to_string(students[i].age) + ",";
-        jsonArray += "\"course\":\"" + students[i].course + "\",";
-        jsonArray += "\"email\":\"" + students[i].email + "\",";
-        jsonArray += "\"gpa\":" + to_string(students[i].gpa) + ",";
-        jsonArray += "\"marks\":" + to_string(students[i].marks);
-        jsonArray += "}";
+        jsonArray += studentToJSON(students[i]);
         
         if (i < students.size() - 1) {
             jsonArray += ",";
@@ -267,186 +1187,1478 @@ string getAllStudentsAPI() {
 }
 
 string searchStudentAPI(int id) {
-    vector<Student> students = loadStudents();
-    
-    for (const auto& student : students) {
-        if (student.id == id) {
-            string studentData = "{";
-            studentData += "\"id\":" + to_string(student.id) + ",";
-            studentData += "\"name\":\"" + student.name + "\",";
-            studentData += "\"age\":" + to_string(student.age) + ",";
-            studentData += "\"course\":\"" + student.course + "\",";
-            studentData += "\"email\":\"" + student.email + "\",";
-            studentData += "\"gpa\":" + to_string(student.gpa) + ",";
-            studentData += "\"marks\":" + to_string(student.marks);
-            studentData += "}";
-            
-            return createJSONResponse("success", "Student found", studentData);
-        }
+    SnapshotPtr snapshot = acquireSnapshot();
+    
+    auto it = snapshot->positionById.find(id);
+    if (it != snapshot->positionById.end()) {
+        return createJSONResponse("success", "Student found", studentToJSON(snapshot->students[it->second]));
     }
     
     return createJSONResponse("error", "Student not found");
 }
 
-string updateStudentAPI(const string& data) {
-    vector<Student> students = loadStudents();
+// GET /api/students/top?by=marks|gpa&k=N[&course=...]
+string topStudentsAPI(const string& query) {
+    SnapshotPtr snapshot = acquireSnapshot();
     
-    // Extract ID
-    int updateId = 0;
-    size_t pos = data.find("\"id\":");
-    if (pos != string::npos) {
-        size_t start = pos + 5;
-        size_t end = data.find(",", start);
-        updateId = stoi(data.substr(start, end - start));
+    string by = getQueryParam(query, "by");
+    string kStr = getQueryParam(query, "k");
+    string course = urlDecode(getQueryParam(query, "course"));
+    int k = kStr.empty() ? 5 : atoi(kStr.c_str());
+    
+    const StudentIndex* index = snapshot->overall.get();
+    if (!course.empty()) {
+        auto it = snapshot->byCourse.find(course);
+        if (it == snapshot->byCourse.end()) {
+            return createJSONResponse("success", "Top students retrieved", "[]");
+        }
+        index = it->second.get();
     }
+    const RankIndex& rank = (by == "gpa") ? index->byGpa : index->byMarks;
     
-    bool found = false;
-    for (auto& student : students) {
-        if (student.id == updateId) {
-            found = true;
-            
-            // Update fields
-            pos = data.find("\"name\":\"");
-            if (pos != string::npos) {
-                size_t start = pos + 8;
-                size_t end = data.find("\"", start);
-                student.name = data.substr(start, end - start);
-            }
-            
-            pos = data.find("\"age\":");
-            if (pos != string::npos) {
-                size_t start = pos + 6;
-                size_t end = data.find(",", start);
-                student.age = stoi(data.substr(start, end - start));
+    string jsonArray = "[";
+    int count = 0;
+    for (auto it = rank.ordered.rbegin(); it != rank.ordered.rend() && count < k; ++it, ++count) {
+        if (count > 0) {
+            jsonArray += ",";
+        }
+        jsonArray += studentToJSON(snapshot->students[snapshot->positionById.at(-it->second)]);
+    }
+    jsonArray += "]";
+    
+    return createJSONResponse("success", "Top students retrieved", jsonArray);
+}
+
+// GET /api/students/{id}/rank?by=marks|gpa[&course=...]
+// With course, the student is ranked among that course, as in /top and
+// /quantile; it must be the student's own course.
+// Rank is 1 for the best student (ties share a rank); percentile is the
+// share of students at or below this student's value.
+string studentRankAPI(int id, const string& query) {
+    SnapshotPtr snapshot = acquireSnapshot();
+    
+    auto pos = snapshot->positionById.find(id);
+    if (pos == snapshot->positionById.end()) {
+        return createJSONResponse("error", "Student not found");
+    }
+    const Student& student = snapshot->students[pos->second];
+    
+    string by = getQueryParam(query, "by");
+    string course = urlDecode(getQueryParam(query, "course"));
+    if (!course.empty() && course != student.course) {
+        return createJSONResponse("error", "Student is not in that course");
+    }
+    const StudentIndex& index = course.empty() ? *snapshot->overall : *snapshot->byCourse.at(student.course);
+    const FenwickTree& counts = (by == "gpa") ? index.byGpa.counts : index.byMarks.counts;
+    
+    return rankResponse(student, by, counts);
+}
+
+// Shared with the router, which passes counts merged from every shard
+string rankResponse(const Student& student, const string& by, const FenwickTree& counts) {
+    int bucket = (by == "gpa") ? gpaBucket(student) : marksBucket(student);
+    
+    int total = counts.total();
+    int atOrBelow = counts.countUpTo(bucket);
+    int rank = total - atOrBelow + 1;
+    double percentile = 100.0 * atOrBelow / total;
+    
+    string data = "{";
+    data += "\"id\":" + to_string(student.id) + ",";
+    data += "\"by\":\"" + string(by == "gpa" ? "gpa" : "marks") + "\",";
+    data += "\"rank\":" + to_string(rank) + ",";
+    data += "\"total\":" + to_string(total) + ",";
+    data += "\"percentile\":" + to_string(percentile);
+    data += "}";
+    
+    return createJSONResponse("success", "Rank computed", data);
+}
+
+// GET /api/students/quantile?by=marks|gpa&q=0.0-1.0[&course=...]
+// Nearest-rank quantile: the smallest value with at least q of students at or below it.
+string quantileAPI(const string& query) {
+    SnapshotPtr snapshot = acquireSnapshot();
+    
+    string by = getQueryParam(query, "by");
+    string qStr = getQueryParam(query, "q");
+    string course = urlDecode(getQueryParam(query, "course"));
+    double q = qStr.empty() ? 0.5 : atof(qStr.c_str());
+    if (q < 0.0 || q > 1.0) {
+        return createJSONResponse("error", "q must be between 0 and 1");
+    }
+    
+    const StudentIndex* index = snapshot->overall.get();
+    if (!course.empty()) {
+        auto it = snapshot->byCourse.find(course);
+        if (it == snapshot->byCourse.end()) {
+            return createJSONResponse("error", "Course not found");
+        }
+        index = it->second.get();
+    }
+    const FenwickTree& counts = (by == "gpa") ? index->byGpa.counts : index->byMarks.counts;
+    
+    return quantileResponse(q, by, counts);
+}
+
+string quantileResponse(double q, const string& by, const FenwickTree& counts) {
+    int total = counts.total();
+    if (total == 0) {
+        return createJSONResponse("error", "No students");
+    }
+    int k = max(1, (int)ceil(q * total));
+    int bucket = counts.findKth(k);
+    string value = (by == "gpa") ? to_string(bucket / 100.0) : to_string(bucket);
+    
+    string data = "{\"q\":" + to_string(q) + ",\"value\":" + value + "}";
+    return createJSONResponse("success", "Quantile computed", data);
+}
+
+string updateStudentAPI(const string& data) {
+    lock_guard<mutex> lock(writerMutex);
+    syncSnapshot();
+    SnapshotPtr snapshot = acquireSnapshot();
+    
+    // Extract ID
+    int updateId = 0;
+    size_t pos = data.find("\"id\":");
+    if (pos != string::npos) {
+        size_t start = pos + 5;
+        size_t end = data.find(",", start);
+        updateId = stoi(data.substr(start, end - start));
+    }
+    
+    auto it = snapshot->positionById.find(updateId);
+    if (it == snapshot->positionById.end()) {
+        return createJSONResponse("error", "Student not found");
+    }
+    Student student = snapshot->students[it->second];
+    
+    // Update fields
+    pos = data.find("\"name\":\"");
+    if (pos != string::npos) {
+        size_t start = pos + 8;
+        size_t end = data.find("\"", start);
+        student.name = data.substr(start, end - start);
+    }
+    
+    pos = data.find("\"age\":");
+    if (pos != string::npos) {
+        size_t start = pos + 6;
+        size_t end = data.find(",", start);
+        student.age = stoi(data.substr(start, end - start));
+    }
+    
+    pos = data.find("\"course\":\"");
+    if (pos != string::npos) {
+        size_t start = pos + 10;
+        size_t end = data.find("\"", start);
+        student.course = data.substr(start, end - start);
+    }
+    
+    pos = data.find("\"email\":\"");
+    if (pos != string::npos) {
+        size_t start = pos + 9;
+        size_t end = data.find("\"", start);
+        student.email = data.substr(start, end - start);
+    }
+    
+    pos = data.find("\"gpa\":");
+    if (pos != string::npos) {
+        size_t start = pos + 6;
+        size_t end = data.find_first_of(",}", start);
+        student.gpa = stof(data.substr(start, end - start));
+    }
+    
+    pos = data.find("\"marks\":");
+    if (pos != string::npos) {
+        size_t start = pos + 8;
+        size_t end = data.find_first_of(",}", start);
+        student.marks = stoi(data.substr(start, end - start));
+    }
+    
+    Student before;
+    if (store.update(student, &before)) {
+        publishWrite(&before, &student);
+        return createJSONResponse("success", "Student updated successfully");
+    }
+    
+    return createJSONResponse("error", store.error());
+}
+
+string deleteStudentAPI(int id) {
+    lock_guard<mutex> lock(writerMutex);
+    syncSnapshot();
+    
+    Student removed;
+    if (store.remove(id, &removed)) {
+        publishWrite(&removed, nullptr);
+        return createJSONResponse("success", "Student deleted successfully");
+    }
+    
+    return createJSONResponse("error", store.error());
+}
+
+SnapshotPtr acquireSnapshot() {
+    return atomic_load(&currentSnapshot);
+}
+
+// Callers must hold writerMutex. version is the store's change version the
+// students correspond to. removed/added describe a single mutation so the
+// rank indexes are carried over from the previous version and patched; with
+// neither, the indexes are rebuilt from scratch.
+void publishSnapshot(vector<Student> students, unsigned long long version,
+                     const Student* removed, const Student* added) {
+    SnapshotPtr current = acquireSnapshot();
+    
+    shared_ptr<StudentSnapshot> next = make_shared<StudentSnapshot>();
+    next->version = version;
+    next->students = std::move(students);
+    
+    for (size_t i = 0; i < next->students.size(); i++) {
+        next->positionById[next->students[i].id] = i;
+    }
+    
+    if (current && (removed || added)) {
+        // Copy-on-write: the overall index and the one or two courses the
+        // write touches are copied and patched, every other course is shared
+        // with the previous version. Copying the overall index (and the
+        // student vector and positionById above) is still O(N) per write;
+        // only the patching itself is O(log N).
+        shared_ptr<StudentIndex> overall = make_shared<StudentIndex>(*current->overall);
+        map<string, shared_ptr<StudentIndex> > touched;
+        const Student* changes[2] = { removed, added };
+        for (int c = 0; c < 2; c++) {
+            if (!changes[c]) continue;
+            const Student& student = *changes[c];
+            shared_ptr<StudentIndex>& course = touched[student.course];
+            if (!course) {
+                auto it = current->byCourse.find(student.course);
+                course = (it == current->byCourse.end()) ? make_shared<StudentIndex>()
+                                                         : make_shared<StudentIndex>(*it->second);
             }
-            
-            pos = data.find("\"course\":\"");
-            if (pos != string::npos) {
-                size_t start = pos + 10;
-                size_t end = data.find("\"", start);
-                student.course = data.substr(start, end - start);
+            indexStudent(*overall, student, (c == 0) ? -1 : +1);
+            indexStudent(*course, student, (c == 0) ? -1 : +1);
+        }
+        
+        next->overall = overall;
+        next->byCourse = current->byCourse;
+        for (const auto& entry : touched) {
+            if (entry.second->byMarks.ordered.empty()) {
+                next->byCourse.erase(entry.first);
+            } else {
+                next->byCourse[entry.first] = entry.second;
             }
-            
-            pos = data.find("\"email\":\"");
-            if (pos != string::npos) {
-                size_t start = pos + 9;
-                size_t end = data.find("\"", start);
-                student.email = data.substr(start, end - start);
+        }
+    } else {
+        shared_ptr<StudentIndex> overall = make_shared<StudentIndex>();
+        map<string, shared_ptr<StudentIndex> > courses;
+        for (const auto& student : next->students) {
+            shared_ptr<StudentIndex>& course = courses[student.course];
+            if (!course) {
+                course = make_shared<StudentIndex>();
             }
-            
-            pos = data.find("\"gpa\":");
-            if (pos != string::npos) {
-                size_t start = pos + 6;
-                size_t end = data.find_first_of(",}", start);
-                student.gpa = stof(data.substr(start, end - start));
+            indexStudent(*overall, student, +1);
+            indexStudent(*course, student, +1);
+        }
+        next->overall = overall;
+        next->byCourse.insert(courses.begin(), courses.end());
+    }
+    
+    atomic_store(&currentSnapshot, SnapshotPtr(next));
+}
+
+// Cheap check on the request path: one load of the shared change version
+void refreshSnapshot() {
+    // A follower's snapshot only changes through the replication stream
+    if (followerMode) {
+        return;
+    }
+    
+    // Hand edits to the data file show up as a new store version
+    store.reloadIfFileChanged();
+    SnapshotPtr snapshot = acquireSnapshot();
+    if (snapshot && snapshot->version == store.version()) {
+        return;
+    }
+    
+    // Readers never wait on a writer: if one is busy here or in another
+    // process, serve the current snapshot and catch up on a later request
+    unique_lock<mutex> lock(writerMutex, try_to_lock);
+    if (lock.owns_lock()) {
+        syncSnapshot(false);
+    }
+}
+
+// Callers must hold writerMutex. Copies the records out of the shared
+// region (no file parsing) if another process has written since. With
+// wait false it gives up if another process holds the region lock.
+void syncSnapshot(bool wait) {
+    SnapshotPtr snapshot = acquireSnapshot();
+    if (snapshot && snapshot->version == store.version()) {
+        return;
+    }
+    
+    uint64_t version;
+    vector<Student> students;
+    if (wait) {
+        students = store.readAll(&version);
+    } else if (!store.tryReadAll(students, &version)) {
+        return;
+    }
+    publishSnapshot(std::move(students), version);
+    
+    // Another process wrote and we can't tell followers what changed
+    resetMutationLog();
+}
+
+// Callers must hold writerMutex and have just applied one mutation to the
+// store. If nobody else wrote in between, the current snapshot is patched;
+// otherwise it is reloaded from the store.
+void publishWrite(const Student* removed, const Student* added) {
+    SnapshotPtr snapshot = acquireSnapshot();
+    unsigned long long version = store.version();
+    
+    if (version != snapshot->version + 1) {
+        syncSnapshot();
+        return;
+    }
+    
+    vector<Student> students = snapshot->students;
+    if (removed && added) {
+        students[snapshot->positionById.at(removed->id)] = *added;
+        appendMutation('U', *added);
+    } else if (removed) {
+        students.erase(students.begin() + snapshot->positionById.at(removed->id));
+        appendMutation('D', *removed);
+    } else {
+        students.push_back(*added);
+        appendMutation('A', *added);
+    }
+    
+    publishSnapshot(std::move(students), version, removed, added);
+}
+
+void appendMutation(char op, const Student& student) {
+    lock_guard<mutex> lock(logMutex);
+    
+    MutationEntry entry;
+    entry.seq = ++lastSeq;
+    entry.op = op;
+    entry.student = student;
+    mutationLog.push_back(entry);
+    
+    if (mutationLog.size() > MUTATION_LOG_CAPACITY) {
+        logBaseSeq = mutationLog.front().seq;
+        mutationLog.pop_front();
+    }
+    logChanged.notify_all();
+}
+
+// Forces every follower onto a full snapshot at the next poll
+void resetMutationLog() {
+    lock_guard<mutex> lock(logMutex);
+    mutationLog.clear();
+    logBaseSeq = ++lastSeq;
+    logChanged.notify_all();
+}
+
+int marksBucket(const Student& student) {
+    return max(0, min(MARKS_BUCKETS - 1, student.marks));
+}
+
+int gpaBucket(const Student& student) {
+    return max(0, min(GPA_BUCKETS - 1, (int)lround(student.gpa * 100)));
+}
+
+// Adds (delta = +1) or removes (delta = -1) a student from one rank index
+// of a snapshot under construction
+void indexStudent(StudentIndex& index, const Student& student, int delta) {
+    index.byMarks.counts.add(marksBucket(student), delta);
+    index.byGpa.counts.add(gpaBucket(student), delta);
+    if (delta > 0) {
+        index.byMarks.ordered.insert(make_pair(marksBucket(student), -student.id));
+        index.byGpa.ordered.insert(make_pair(gpaBucket(student), -student.id));
+    } else {
+        index.byMarks.ordered.erase(make_pair(marksBucket(student), -student.id));
+        index.byGpa.ordered.erase(make_pair(gpaBucket(student), -student.id));
+    }
+}
+
+// GET /api/replication/log?epoch=E&from=SEQ&wait=MS  (plain text)
+// Long-polls up to wait ms for writes after SEQ and answers either
+//   LOG <epoch> <lastSeq>             followed by exactly lastSeq - SEQ
+//                                     "A|U <record>" / "D <id>" lines, or
+//   SNAPSHOT <epoch> <lastSeq> <n>    followed by all n records, when E is
+//                                     not this run's epoch (new follower or
+//                                     restarted primary) or SEQ is no
+//                                     longer covered by the log
+string replicationLogAPI(const string& query) {
+    if (followerMode) {
+        return "ERROR not a primary\n";
+    }
+    refreshSnapshot();
+    
+    unsigned long long epoch = strtoull(getQueryParam(query, "epoch").c_str(), nullptr, 10);
+    unsigned long long from = strtoull(getQueryParam(query, "from").c_str(), nullptr, 10);
+    int waitMs = max(0, min(REPLICATION_MAX_WAIT_MS, atoi(getQueryParam(query, "wait").c_str())));
+    
+    if (epoch == replicationEpoch) {
+        unique_lock<mutex> lock(logMutex);
+        if (from >= logBaseSeq && from <= lastSeq) {
+            logChanged.wait_for(lock, chrono::milliseconds(waitMs),
+                                [from] { return lastSeq != from || from < logBaseSeq; });
+        }
+        if (from >= logBaseSeq && from <= lastSeq) {
+            string body = "LOG " + to_string(replicationEpoch) + " " + to_string(lastSeq) + "\n";
+            for (size_t i = (size_t)(from - logBaseSeq); i < mutationLog.size(); i++) {
+                const MutationEntry& entry = mutationLog[i];
+                if (entry.op == 'D') {
+                    body += "D " + to_string(entry.student.id) + "\n";
+                } else {
+                    body += string(1, entry.op) + " " + formatStudentRecord(entry.student);
+                }
             }
-            
-            pos = data.find("\"marks\":");
-            if (pos != string::npos) {
-                size_t start = pos + 8;
-                size_t end = data.find_first_of(",}", start);
-                student.marks = stoi(data.substr(start, end - start));
+            return body;
+        }
+    }
+    
+    // Both locks so the snapshot matches lastSeq exactly
+    lock_guard<mutex> writeLock(writerMutex);
+    lock_guard<mutex> lock(logMutex);
+    SnapshotPtr snapshot = acquireSnapshot();
+    
+    string body = "SNAPSHOT " + to_string(replicationEpoch) + " " + to_string(lastSeq) + " " +
+                  to_string(snapshot->students.size()) + "\n";
+    for (const auto& student : snapshot->students) {
+        body += formatStudentRecord(student);
+    }
+    return body;
+}
+
+// GET /api/replication/status
+string replicationStatusAPI() {
+    string data = "{";
+    if (followerMode) {
+        data += "\"role\":\"follower\",";
+        data += "\"primary\":\"" + primaryHost + ":" + to_string(primaryPort) + "\",";
+        data += "\"connected\":" + string(primaryReachable ? "true" : "false") + ",";
+        data += "\"appliedSeq\":" + to_string(appliedSeq.load()) + ",";
+        data += "\"lagMs\":" + to_string(replicationLagMs());
+    } else {
+        lock_guard<mutex> lock(logMutex);
+        data += "\"role\":\"primary\",";
+        data += "\"lastSeq\":" + to_string(lastSeq) + ",";
+        data += "\"oldestSeq\":" + to_string(logBaseSeq);
+    }
+    data += "}";
+    
+    return createJSONResponse("success", "Replication status", data);
+}
+
+// Follower thread: long-polls the primary's log and applies what comes back
+void followPrimary() {
+    while (true) {
+        unsigned long long from = appliedSeq;
+        string request = "GET /api/replication/log?epoch=" + to_string(followedEpoch.load()) +
+                         "&from=" + to_string(from) +
+                         "&wait=" + to_string(REPLICATION_POLL_WAIT_MS) + " HTTP/1.1\r\n";
+        request += "Host: " + primaryHost + "\r\n";
+        request += "Connection: close\r\n\r\n";
+        
+        pollStartedMs = steadyNowMs();
+        string response = httpExchange(primaryHost, primaryPort, request, REPLICATION_MAX_WAIT_MS + 2000);
+        string body;
+        if (parseHttpResponse(response, body) != 200 || !applyReplicationBatch(body, from)) {
+            if (primaryReachable) {
+                cerr << "Lost connection to primary " << primaryHost << ":" << primaryPort << "\n";
             }
+            primaryReachable = false;
+            this_thread::sleep_for(chrono::seconds(1));
+            continue;
+        }
+        
+        primaryReachable = true;
+        lastCaughtUpMs = steadyNowMs();
+    }
+}
+
+// Every poll that returns brings the follower fully up to date, and the
+// primary answers a pending poll as soon as it commits. So while polls keep
+// succeeding the replica is current; otherwise the lag is the time since the
+// last poll that did.
+long long replicationLagMs() {
+    long long caughtUp = lastCaughtUpMs;
+    if (caughtUp < 0) {
+        return -1;
+    }
+    long long now = steadyNowMs();
+    if (primaryReachable && now - pollStartedMs <= REPLICATION_POLL_WAIT_MS + 2000) {
+        return 0;
+    }
+    return now - caughtUp;
+}
+
+// Checks the whole batch before touching the snapshot: a body that is cut
+// short, from another primary run, or unparsable is rejected so the poll is
+// retried instead of leaving the replica silently missing records.
+bool applyReplicationBatch(const string& body, unsigned long long from) {
+    istringstream stream(body);
+    string kind, line;
+    unsigned long long epoch = 0, seq = 0;
+    size_t expected = 0;
+    stream >> kind >> epoch >> seq;
+    if (kind == "SNAPSHOT") {
+        stream >> expected;
+    }
+    getline(stream, line);
+    if (!stream) {
+        return false;
+    }
+    
+    vector<MutationEntry> entries;
+    try {
+        while (getline(stream, line)) {
+            if (line.empty()) continue;
             
-            saveStudents(students);
-            break;
+            MutationEntry entry;
+            entry.seq = 0;
+            if (kind == "SNAPSHOT") {
+                entry.op = 'A';
+                entry.student = parseStudentRecord(line);
+            } else if (line.size() > 2 && line[1] == ' ' && (line[0] == 'A' || line[0] == 'U' || line[0] == 'D')) {
+                entry.op = line[0];
+                if (entry.op == 'D') {
+                    entry.student.id = stoi(line.substr(2));
+                } else {
+                    entry.student = parseStudentRecord(line.substr(2));
+                }
+            } else {
+                return false;
+            }
+            entries.push_back(entry);
         }
+    } catch (const exception&) {
+        return false;
     }
     
-    if (found) {
-        return createJSONResponse("success", "Student updated successfully");
+    lock_guard<mutex> lock(writerMutex);
+    
+    if (kind == "SNAPSHOT") {
+        if (entries.size() != expected) {
+            return false;
+        }
+        vector<Student> students;
+        students.reserve(entries.size());
+        for (const auto& entry : entries) {
+            students.push_back(entry.student);
+        }
+        publishSnapshot(std::move(students), seq);
+        followedEpoch = epoch;
+        appliedSeq = seq;
+        cout << "Replica loaded snapshot at seq " << seq << "\n";
+        return true;
+    }
+    if (kind != "LOG" || epoch != followedEpoch || seq < from || entries.size() != seq - from) {
+        // Start over from a snapshot
+        followedEpoch = 0;
+        appliedSeq = 0;
+        return false;
+    }
+    if (entries.empty()) {
+        return true;
     }
     
-    return createJSONResponse("error", "Student not found");
+    SnapshotPtr snapshot = acquireSnapshot();
+    vector<Student> students = snapshot->students;
+    unordered_map<int, size_t> positionById = snapshot->positionById;
+    vector<bool> deleted(students.size(), false);
+    Student removed;
+    bool hasRemoved = false;
+    
+    for (const auto& entry : entries) {
+        auto it = positionById.find(entry.student.id);
+        hasRemoved = (it != positionById.end());
+        if (hasRemoved) removed = students[it->second];
+        
+        if (entry.op == 'D') {
+            if (hasRemoved) {
+                deleted[it->second] = true;
+                positionById.erase(it);
+            }
+        } else if (hasRemoved) {
+            students[it->second] = entry.student;
+        } else {
+            positionById[entry.student.id] = students.size();
+            students.push_back(entry.student);
+            deleted.push_back(false);
+        }
+    }
+    
+    // Deletes are compacted once, keeping the primary's order
+    if (find(deleted.begin(), deleted.end(), true) != deleted.end()) {
+        vector<Student> remaining;
+        remaining.reserve(students.size());
+        for (size_t i = 0; i < students.size(); i++) {
+            if (!deleted[i]) remaining.push_back(students[i]);
+        }
+        students.swap(remaining);
+    }
+    
+    if (entries.size() == 1) {
+        const MutationEntry& entry = entries[0];
+        publishSnapshot(std::move(students), seq, hasRemoved ? &removed : nullptr,
+                        entry.op != 'D' ? &entry.student : nullptr);
+    } else {
+        // Several writes at once: rebuilding the indexes beats patching each
+        publishSnapshot(std::move(students), seq);
+    }
+    appliedSeq = seq;
+    return true;
 }
 
-string deleteStudentAPI(int id) {
-    vector<Student> students = loadStudents();
-    size_t originalSize = students.size();
+// Followers are read-only: writes are relayed to the primary verbatim
+void forwardToPrimary(SOCKET socket, const string& request, const string& client) {
+    // Placed first so it wins over any X-Forwarded-For the client sent
+    string relayed = request;
+    size_t lineEnd = relayed.find("\r\n");
+    if (lineEnd != string::npos) {
+        relayed.insert(lineEnd + 2, "X-Forwarded-For: " + client + "\r\n");
+    }
+    string response = httpExchange(primaryHost, primaryPort, relayed, 10000);
+    if (response.empty()) {
+        sendHttpResponse(socket, 503, createJSONResponse("error", "Primary unavailable"), "Retry-After: 1\r\n");
+        return;
+    }
+    sendAll(socket, response.c_str(), response.length());
+}
+
+long long steadyNowMs() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Sends a raw HTTP request and returns the raw response, or "" on failure.
+// Reads until the peer closes, which this server does after every response.
+string httpExchange(const string& host, int port, const string& request, int timeoutMs) {
+    struct addrinfo hints, *result = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &result) != 0) {
+        return "";
+    }
     
-    students.erase(
-        std::remove_if(students.begin(), students.end(), 
-                       [id](const Student& s) { return s.id == id; }),
-        students.end()
-    );
+    SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET) {
+        freeaddrinfo(result);
+        return "";
+    }
     
-    if (students.size() < originalSize) {
-        saveStudents(students);
-        return createJSONResponse("success", "Student deleted successfully");
+    setSocketTimeouts(sock, timeoutMs);
+    
+    bool connected = connect(sock, result->ai_addr, (int)result->ai_addrlen) != SOCKET_ERROR;
+    freeaddrinfo(result);
+    if (!connected || !sendAll(sock, request.c_str(), request.length())) {
+        closesocket(sock);
+        return "";
     }
     
-    return createJSONResponse("error", "Student not found");
+    string response;
+    char buffer[16384];
+    int received;
+    while ((received = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+        response.append(buffer, received);
+    }
+    closesocket(sock);
+    
+    return response;
 }
 
-vector<Student> loadStudents() {
-    vector<Student> students;
-    ifstream file(FILENAME);
+// Returns the status code and splits off the body. 0 if malformed or if
+// the body is shorter or longer than its Content-Length (a cut-off read).
+int parseHttpResponse(const string& response, string& body) {
+    size_t headerEnd = response.find("\r\n\r\n");
+    if (response.compare(0, 9, "HTTP/1.1 ") != 0 || headerEnd == string::npos) {
+        return 0;
+    }
+    body = response.substr(headerEnd + 4);
     
-    if (file.is_open()) {
-        string line;
-        while (getline(file, line)) {
-            if (line.empty()) continue;
-            
-            Student student;
-            stringstream ss(line);
-            string temp;
-            
-            getline(ss, temp, '|');
-            student.id = stoi(temp);
-            
-            getline(ss, student.name, '|');
-            
-            getline(ss, temp, '|');
-            student.age = stoi(temp);
-            
-            getline(ss, student.course, '|');
-            getline(ss, student.email, '|');
-            
-            getline(ss, temp, '|');
-            student.gpa = stof(temp);
-            
-            getline(ss, temp, '|');
-            if (!temp.empty()) {
-                student.marks = stoi(temp);
+    string length = getHeader(response.substr(0, headerEnd + 2), "Content-Length");
+    if (length.empty() || strtoull(length.c_str(), nullptr, 10) != body.size()) {
+        return 0;
+    }
+    return atoi(response.c_str() + 9);
+}
+
+bool parseRange(const string& text, int& lo, int& hi) {
+    size_t dash = text.find('-');
+    if (dash == string::npos) {
+        return false;
+    }
+    lo = atoi(text.substr(0, dash).c_str());
+    hi = atoi(text.substr(dash + 1).c_str());
+    return lo > 0 && lo <= hi;
+}
+
+// Next id after the highest one in this shard's range; 0 when the range is used up
+int nextShardId(const StudentSnapshot& snapshot) {
+    int highest = shardLo - 1;
+    for (const auto& student : snapshot.students) {
+        if (student.id >= shardLo && student.id <= shardHi) {
+            highest = max(highest, student.id);
+        }
+    }
+    return (highest < shardHi) ? highest + 1 : 0;
+}
+
+// GET /api/shard/histogram?by=marks|gpa[&course=...]  (plain text)
+// Per-bucket counts so the router can merge rank and quantile across shards:
+//   HIST <buckets>  followed by "<bucket> <count>" for non-empty buckets
+string shardHistogramAPI(const string& query) {
+    refreshSnapshot();
+    SnapshotPtr snapshot = acquireSnapshot();
+    
+    string by = getQueryParam(query, "by");
+    string course = urlDecode(getQueryParam(query, "course"));
+    int buckets = (by == "gpa") ? GPA_BUCKETS : MARKS_BUCKETS;
+    
+    string body = "HIST " + to_string(buckets) + "\n";
+    const StudentIndex* index = snapshot->overall.get();
+    if (!course.empty()) {
+        auto it = snapshot->byCourse.find(course);
+        if (it == snapshot->byCourse.end()) {
+            return body;
+        }
+        index = it->second.get();
+    }
+    const FenwickTree& counts = (by == "gpa") ? index->byGpa.counts : index->byMarks.counts;
+    
+    int below = 0;
+    for (int bucket = 0; bucket < buckets; bucket++) {
+        int upTo = counts.countUpTo(bucket);
+        if (upTo > below) {
+            body += to_string(bucket) + " " + to_string(upTo - below) + "\n";
+        }
+        below = upTo;
+    }
+    return body;
+}
+
+// GET /api/shard/export?lo=N&hi=N  (plain text)
+//   EXPORT <count>  followed by one record per line
+string shardExportAPI(const string& query) {
+    refreshSnapshot();
+    SnapshotPtr snapshot = acquireSnapshot();
+    
+    int lo = atoi(getQueryParam(query, "lo").c_str());
+    int hi = atoi(getQueryParam(query, "hi").c_str());
+    
+    string records = "";
+    size_t count = 0;
+    for (const auto& student : snapshot->students) {
+        if (student.id >= lo && student.id <= hi) {
+            records += formatStudentRecord(student);
+            count++;
+        }
+    }
+    return "EXPORT " + to_string(count) + "\n" + records;
+}
+
+// POST /api/shard/import {"source":"host:port","lo":N,"hi":N}
+// Pulls ids [lo, hi] from another shard and takes ownership of that range.
+// Records already here in the range are replaced, so a retry is harmless.
+string shardImportAPI(const string& data) {
+    string source = jsonString(data, "source");
+    int lo = jsonInt(data, "lo");
+    int hi = jsonInt(data, "hi");
+    size_t colon = source.rfind(':');
+    if (colon == string::npos || lo <= 0 || lo > hi) {
+        return createJSONResponse("error", "Expected source, lo and hi");
+    }
+    
+    ShardRoute from;
+    from.host = source.substr(0, colon);
+    from.port = atoi(source.substr(colon + 1).c_str());
+    string request = "GET /api/shard/export?lo=" + to_string(lo) + "&hi=" + to_string(hi) + " HTTP/1.1\r\n";
+    request += "Host: " + from.host + "\r\nConnection: close\r\n\r\n";
+    string response = httpExchange(from.host, from.port, request, SHARD_TRANSFER_TIMEOUT_MS);
+    string body;
+    if (parseHttpResponse(response, body) != 200) {
+        return createJSONResponse("error", "Could not read from source shard");
+    }
+    
+    // Nothing is stored unless every promised record arrived and parsed
+    vector<Student> imported;
+    istringstream lines(body);
+    string line, kind;
+    size_t expected = 0;
+    lines >> kind >> expected;
+    getline(lines, line);
+    try {
+        while (getline(lines, line)) {
+            if (!line.empty()) imported.push_back(parseStudentRecord(line));
+        }
+    } catch (const exception&) {
+        return createJSONResponse("error", "Source shard sent a malformed record");
+    }
+    if (kind != "EXPORT" || imported.size() != expected) {
+        return createJSONResponse("error", "Source shard sent " + to_string(imported.size()) + " of " +
+                                           to_string(expected) + " records");
+    }
+    for (const auto& student : imported) {
+        if (student.id < lo || student.id > hi) {
+            return createJSONResponse("error", "Source shard sent ID " + to_string(student.id) + " outside the range");
+        }
+    }
+    
+    // The shard ends up owning exactly [lo, hi], so anything else here
+    // would be served by two shards
+    lock_guard<mutex> lock(writerMutex);
+    bool foreign = false;
+    bool ok = store.transaction([&](vector<Student>& students) {
+        foreign = any_of(students.begin(), students.end(),
+                         [lo, hi](const Student& s) { return s.id < lo || s.id > hi; });
+        if (foreign) {
+            return false;
+        }
+        students.clear();
+        students.insert(students.end(), imported.begin(), imported.end());
+        return true;
+    });
+    if (foreign) {
+        return createJSONResponse("error", "This shard holds ids outside " + to_string(lo) + "-" + to_string(hi));
+    }
+    if (!ok) {
+        return createJSONResponse("error", store.error());
+    }
+    shardLo = lo;
+    shardHi = hi;
+    syncSnapshot();
+    
+    cout << "Imported " << imported.size() << " students for ids " << lo << "-" << hi << "\n";
+    return createJSONResponse("success", "Range imported", "{\"moved\":" + to_string(imported.size()) + "}");
+}
+
+// POST /api/shard/drop {"lo":N,"hi":N[,"expect":N]}
+// Deletes a range that now lives elsewhere and stops owning it. Only the
+// top or bottom end of the owned range can go, never all of it. With
+// expect, nothing is dropped unless the range holds exactly that many
+// records, i.e. the copy elsewhere is complete.
+string shardDropAPI(const string& data) {
+    int lo = jsonInt(data, "lo");
+    int hi = jsonInt(data, "hi");
+    int expect = jsonInt(data, "expect", -1);
+    if (lo <= 0 || lo > hi) {
+        return createJSONResponse("error", "Expected lo and hi");
+    }
+    bool top = (lo > shardLo && lo <= shardHi && hi == shardHi);
+    bool bottom = (lo == shardLo && hi >= shardLo && hi < shardHi);
+    if (!top && !bottom) {
+        return createJSONResponse("error", "Can only drop the top or bottom of ids " + to_string(shardLo.load()) +
+                                           "-" + to_string(shardHi.load()));
+    }
+    
+    lock_guard<mutex> lock(writerMutex);
+    syncSnapshot();
+    SnapshotPtr snapshot = acquireSnapshot();
+    size_t held = count_if(snapshot->students.begin(), snapshot->students.end(),
+                           [lo, hi](const Student& s) { return s.id >= lo && s.id <= hi; });
+    if (expect >= 0 && held != (size_t)expect) {
+        return createJSONResponse("error", "Range holds " + to_string(held) + " records, expected " +
+                                           to_string(expect) + "; nothing dropped");
+    }
+    
+    bool ok = store.transaction([lo, hi](vector<Student>& students) {
+        size_t before = students.size();
+        students.erase(remove_if(students.begin(), students.end(),
+                                 [lo, hi](const Student& s) { return s.id >= lo && s.id <= hi; }),
+                       students.end());
+        return students.size() != before;
+    });
+    if (!ok) {
+        return createJSONResponse("error", store.error());
+    }
+    if (top) {
+        shardHi = lo - 1;
+    } else {
+        shardLo = hi + 1;
+    }
+    syncSnapshot();
+    
+    return createJSONResponse("success", "Range dropped", "{\"dropped\":" + to_string(held) + "}");
+}
+
+// GET /api/shard/info[?lo=N&hi=N]
+// count covers every record, or only ids [lo, hi] when given
+string shardInfoAPI(const string& query) {
+    SnapshotPtr snapshot = acquireSnapshot();
+    size_t count = snapshot->students.size();
+    if (!getQueryParam(query, "lo").empty()) {
+        int lo = atoi(getQueryParam(query, "lo").c_str());
+        int hi = atoi(getQueryParam(query, "hi").c_str());
+        count = count_if(snapshot->students.begin(), snapshot->students.end(),
+                         [lo, hi](const Student& s) { return s.id >= lo && s.id <= hi; });
+    }
+    string data = "{\"lo\":" + to_string(shardLo.load()) + ",\"hi\":" + to_string(shardHi.load()) +
+                  ",\"count\":" + to_string(count) + "}";
+    return createJSONResponse("success", "Shard info", data);
+}
+
+// Router: by-id requests go to the owning shard; list, top, rank and
+// quantile fan out to every shard in parallel and are merged here
+void routeRequest(SOCKET socket, const string& request) {
+    istringstream stream(request);
+    string method, path;
+    stream >> method >> path;
+    
+    string query = "";
+    size_t queryPos = path.find('?');
+    if (queryPos != string::npos) {
+        query = path.substr(queryPos + 1);
+        path = path.substr(0, queryPos);
+    }
+    
+    string body = "";
+    size_t bodyPos = request.find("\r\n\r\n");
+    if (bodyPos != string::npos) {
+        body = request.substr(bodyPos + 4);
+    }
+    
+    string by = (getQueryParam(query, "by") == "gpa") ? "gpa" : "marks";
+    string response;
+    
+    if (method == "OPTIONS") {
+        response = "{}";
+    } else if (path == "/api/shard/map" && method == "GET") {
+        response = shardMapAPI();
+    } else if (path == "/api/shard/split" && method == "POST") {
+        response = splitShardAPI(body);
+    } else if (path == "/api/shard/split" && method == "GET") {
+        response = splitStatusAPI();
+    } else if (path == "/api/students" && method == "POST") {
+        forwardToShard(socket, request, jsonInt(body, "id"), true);
+        return;
+    } else if (path == "/api/students" && method == "GET") {
+        shared_lock<shared_timed_mutex> lock(splitLock);
+        vector<string> bodies;
+        if (!fanOut("/api/students", bodies)) {
+            sendHttpResponse(socket, 503, createJSONResponse("error", "Shard unavailable"), "Retry-After: 1\r\n");
+            return;
+        }
+        string merged = "";
+        for (const auto& shardBody : bodies) {
+            string items = jsonDataArray(shardBody);
+            if (!items.empty()) {
+                merged += (merged.empty() ? "" : ",") + items;
+            }
+        }
+        response = createJSONResponse("success", "Students retrieved", "[" + merged + "]");
+    } else if (path == "/api/students/top" && method == "GET") {
+        string kStr = getQueryParam(query, "k");
+        int k = kStr.empty() ? 5 : atoi(kStr.c_str());
+        
+        // Each shard's top k is enough to contain the global top k
+        shared_lock<shared_timed_mutex> lock(splitLock);
+        vector<string> bodies;
+        if (!fanOut("/api/students/top?" + query, bodies)) {
+            sendHttpResponse(socket, 503, createJSONResponse("error", "Shard unavailable"), "Retry-After: 1\r\n");
+            return;
+        }
+        response = createJSONResponse("success", "Top students retrieved", mergeTopStudents(bodies, by, k));
+    } else if (path == "/api/students/quantile" && method == "GET") {
+        string qStr = getQueryParam(query, "q");
+        string course = getQueryParam(query, "course");
+        double q = qStr.empty() ? 0.5 : atof(qStr.c_str());
+        FenwickTree counts;
+        if (q < 0.0 || q > 1.0) {
+            response = createJSONResponse("error", "q must be between 0 and 1");
+        } else if (!mergedHistogram(by, course, counts)) {
+            sendHttpResponse(socket, 503, createJSONResponse("error", "Shard unavailable"), "Retry-After: 1\r\n");
+            return;
+        } else if (!course.empty() && counts.total() == 0) {
+            response = createJSONResponse("error", "Course not found");
+        } else {
+            response = quantileResponse(q, by, counts);
+        }
+    } else if (path.find("/api/students/") == 0 && path.size() > 19 &&
+               path.compare(path.size() - 5, 5, "/rank") == 0 && method == "GET") {
+        // The owner supplies the student's value; the rank needs everyone's counts
+        int id = atoi(path.substr(14).c_str());
+        ShardRoute owner;
+        bool found = false;
+        {
+            lock_guard<mutex> lock(routeMutex);
+            for (const auto& route : shardRoutes) {
+                if (id >= route.lo && id <= route.hi) {
+                    owner = route;
+                    found = true;
+                }
+            }
+        }
+        string ownerBody = found ? shardGet(owner, "/api/students/" + to_string(id)) : "";
+        size_t dataPos = ownerBody.find("\"data\":{");
+        FenwickTree counts;
+        if (dataPos == string::npos) {
+            response = createJSONResponse("error", "Student not found");
+        } else {
+            Student student = studentFromJSON(ownerBody.substr(dataPos + 7));
+            string course = urlDecode(getQueryParam(query, "course"));
+            shared_lock<shared_timed_mutex> lock(splitLock);
+            if (!course.empty() && course != student.course) {
+                response = createJSONResponse("error", "Student is not in that course");
+            } else if (!mergedHistogram(by, urlEncode(course), counts)) {
+                sendHttpResponse(socket, 503, createJSONResponse("error", "Shard unavailable"), "Retry-After: 1\r\n");
+                return;
             } else {
-                student.marks = 0;
+                response = rankResponse(student, by, counts);
             }
-            
-            students.push_back(student);
         }
-        file.close();
+    } else if (path.find("/api/students/") == 0 && method == "GET") {
+        forwardToShard(socket, request, atoi(path.substr(14).c_str()), false);
+        return;
+    } else if (path.find("/api/students/") == 0 && method == "PUT") {
+        // The server takes the id from the body
+        forwardToShard(socket, request, jsonInt(body, "id", atoi(path.substr(14).c_str())), true);
+        return;
+    } else if (path.find("/api/students/") == 0 && method == "DELETE") {
+        forwardToShard(socket, request, atoi(path.substr(14).c_str()), true);
+        return;
+    } else {
+        response = createJSONResponse("error", "Invalid endpoint");
     }
     
-    return students;
+    sendHttpResponse(socket, 200, response);
 }
 
-void saveStudents(const vector<Student>& students) {
-    ofstream file(FILENAME);
+// Relays a request to the shard owning id. An add without an id goes to
+// the highest range, which assigns the next id from it, as a single server
+// would, so it counts as the top of that range. Writes to the part of a
+// range being split off are turned away until it finishes.
+void forwardToShard(SOCKET socket, const string& request, int id, bool isWrite) {
+    unique_lock<mutex> lock(routeMutex);
+    int index = -1;
+    if (id == 0) {
+        index = (int)shardRoutes.size() - 1;
+    } else {
+        for (size_t i = 0; i < shardRoutes.size(); i++) {
+            if (id >= shardRoutes[i].lo && id <= shardRoutes[i].hi) {
+                index = (int)i;
+            }
+        }
+        if (index < 0) {
+            lock.unlock();
+            sendHttpResponse(socket, 200, createJSONResponse("error", "No shard owns this ID"));
+            return;
+        }
+    }
+    
+    int key = (id == 0) ? INT_MAX : id;
+    if (isWrite && shardRoutes[index].frozen && key >= shardRoutes[index].frozenLo) {
+        lock.unlock();
+        sendHttpResponse(socket, 503, createJSONResponse("error", "Shard is being split, please retry"),
+                         "Retry-After: 1\r\n");
+        return;
+    }
+    
+    ShardRoute target = shardRoutes[index];
+    if (isWrite) {
+        shardRoutes[index].writesInFlight.insert(key);
+    }
+    lock.unlock();
     
-    if (file.is_open()) {
-        for (const auto& student : students) {
-            file << student.id << "|" << student.name << "|" << student.age << "|" 
-                 << student.course << "|" << student.email << "|" << student.gpa << "|" << student.marks << "\n";
+    string response = httpExchange(target.host, target.port, request, SHARD_TIMEOUT_MS);
+    
+    if (isWrite) {
+        // A split elsewhere may have shifted entries; each server owns one range
+        lock.lock();
+        for (auto& route : shardRoutes) {
+            auto it = route.writesInFlight.find(key);
+            if (route.host == target.host && route.port == target.port && it != route.writesInFlight.end()) {
+                route.writesInFlight.erase(it);
+            }
         }
-        file.close();
+        lock.unlock();
+        routeChanged.notify_all();
+    }
+    
+    if (response.empty()) {
+        sendHttpResponse(socket, 503, createJSONResponse("error", "Shard unavailable"), "Retry-After: 1\r\n");
+        return;
+    }
+    sendAll(socket, response.c_str(), response.length());
+}
+
+// GETs pathAndQuery from every shard at once. Fails if any shard does:
+// a merge missing one shard would look complete but be wrong.
+bool fanOut(const string& pathAndQuery, vector<string>& bodies) {
+    vector<ShardRoute> routes;
+    {
+        lock_guard<mutex> lock(routeMutex);
+        routes = shardRoutes;
     }
+    
+    bodies.assign(routes.size(), "");
+    vector<char> ok(routes.size(), 0);
+    vector<thread> workers;
+    for (size_t i = 0; i < routes.size(); i++) {
+        workers.emplace_back([&, i] {
+            string request = "GET " + pathAndQuery + " HTTP/1.1\r\nHost: " + routes[i].host +
+                             "\r\nConnection: close\r\n\r\n";
+            ok[i] = parseHttpResponse(httpExchange(routes[i].host, routes[i].port, request, SHARD_TIMEOUT_MS),
+                                      bodies[i]) == 200;
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    
+    return find(ok.begin(), ok.end(), 0) == ok.end();
+}
+
+// Body of a GET to one shard, or "" on failure
+string shardGet(const ShardRoute& route, const string& pathAndQuery, int timeoutMs) {
+    string request = "GET " + pathAndQuery + " HTTP/1.1\r\nHost: " + route.host + "\r\nConnection: close\r\n\r\n";
+    string body;
+    return (parseHttpResponse(httpExchange(route.host, route.port, request, timeoutMs), body) == 200) ? body : "";
+}
+
+string shardPost(const ShardRoute& route, const string& path, const string& body, int timeoutMs) {
+    string request = "POST " + path + " HTTP/1.1\r\nHost: " + route.host + "\r\n";
+    request += "Content-Type: application/json\r\n";
+    request += "Content-Length: " + to_string(body.length()) + "\r\n";
+    request += "Connection: close\r\n\r\n" + body;
+    string reply;
+    return (parseHttpResponse(httpExchange(route.host, route.port, request, timeoutMs), reply) == 200) ? reply : "";
+}
+
+// Sums every shard's bucket counts into one tree (course is URL-encoded)
+bool mergedHistogram(const string& by, const string& course, FenwickTree& counts) {
+    vector<string> bodies;
+    string path = "/api/shard/histogram?by=" + by + (course.empty() ? "" : "&course=" + course);
+    if (!fanOut(path, bodies)) {
+        return false;
+    }
+    
+    counts = FenwickTree(by == "gpa" ? GPA_BUCKETS : MARKS_BUCKETS);
+    for (const auto& body : bodies) {
+        istringstream lines(body);
+        string header;
+        getline(lines, header);
+        int bucket, count;
+        while (lines >> bucket >> count) {
+            counts.add(bucket, count);
+        }
+    }
+    return true;
+}
+
+// Same order as a single server: best bucket first, lower id first on ties
+string mergeTopStudents(const vector<string>& bodies, const string& by, int k) {
+    vector<pair<pair<int, int>, string> > candidates;
+    for (const auto& body : bodies) {
+        for (const auto& object : splitJSONObjects(jsonDataArray(body))) {
+            Student student = studentFromJSON(object);
+            int bucket = (by == "gpa") ? gpaBucket(student) : marksBucket(student);
+            candidates.push_back(make_pair(make_pair(-bucket, student.id), object));
+        }
+    }
+    sort(candidates.begin(), candidates.end());
+    
+    string jsonArray = "[";
+    for (int i = 0; i < k && i < (int)candidates.size(); i++) {
+        if (i > 0) {
+            jsonArray += ",";
+        }
+        jsonArray += candidates[i].second;
+    }
+    jsonArray += "]";
+    return jsonArray;
+}
+
+// POST /api/shard/split {"at":ID,"target":"host:port"}
+// Moves ids [at, hi] of the shard holding `at` onto a running, empty server.
+// The copy can take a while, so it runs on its own thread and this returns
+// at once; GET /api/shard/split reports how it went.
+string splitShardAPI(const string& data) {
+    int at = jsonInt(data, "at");
+    string target = jsonString(data, "target");
+    size_t colon = target.rfind(':');
+    if (colon == string::npos || at <= 0) {
+        return createJSONResponse("error", "Expected at and target");
+    }
+    
+    ShardRoute added;
+    added.host = target.substr(0, colon);
+    added.port = atoi(target.substr(colon + 1).c_str());
+    added.frozen = false;
+    added.frozenLo = INT_MAX;
+    
+    {
+        lock_guard<mutex> lock(routeMutex);
+        bool splittable = any_of(shardRoutes.begin(), shardRoutes.end(),
+                                 [at](const ShardRoute& route) { return at > route.lo && at <= route.hi; });
+        if (!splittable) {
+            return createJSONResponse("error", "No shard can be split at that ID");
+        }
+        for (const auto& route : shardRoutes) {
+            if (route.host == added.host && route.port == added.port) {
+                return createJSONResponse("error", "Target already owns ids " + to_string(route.lo) + "-" +
+                                                   to_string(route.hi));
+            }
+        }
+    }
+    
+    bool idle = false;
+    if (!splitRunning.compare_exchange_strong(idle, true)) {
+        return createJSONResponse("error", "A split is already running");
+    }
+    thread([at, added] {
+        string result = runSplit(at, added);
+        {
+            lock_guard<mutex> lock(routeMutex);
+            lastSplitResult = result;
+        }
+        splitRunning = false;
+    }).detach();
+    
+    string started = "{\"at\":" + to_string(at) + ",\"target\":\"" + target + "\"}";
+    return createJSONResponse("success", "Split started", started);
+}
+
+// GET /api/shard/split
+string splitStatusAPI() {
+    lock_guard<mutex> lock(routeMutex);
+    string data = "{\"running\":" + string(splitRunning ? "true" : "false") +
+                  ",\"last\":" + (lastSplitResult.empty() ? "null" : lastSplitResult) + "}";
+    return createJSONResponse("success", "Split status", data);
 }
 
-int generateNewId() {
-    vector<Student> students = loadStudents();
+// Only writes to the moving range pause: they are refused from the moment
+// the range is frozen until the table points at the new shard. Reads keep
+// going to the old shard, which holds the data until the switch.
+string runSplit(int at, ShardRoute added) {
+    string target = added.host + ":" + to_string(added.port);
+    size_t index = 0;
+    ShardRoute source;
+    {
+        unique_lock<mutex> lock(routeMutex);
+        while (index < shardRoutes.size() && !(at > shardRoutes[index].lo && at <= shardRoutes[index].hi)) {
+            index++;
+        }
+        if (index == shardRoutes.size()) {
+            return createJSONResponse("error", "No shard can be split at that ID");
+        }
+        // Writes to the ids the source keeps carry on; only those already
+        // under way to the moving part are waited for
+        shardRoutes[index].frozen = true;
+        shardRoutes[index].frozenLo = at;
+        routeChanged.wait(lock, [index, at] {
+            return shardRoutes[index].writesInFlight.lower_bound(at) == shardRoutes[index].writesInFlight.end();
+        });
+        source = shardRoutes[index];
+    }
+    added.lo = at;
+    added.hi = source.hi;
     
-    if (students.empty()) {
-        return 1001;
+    string range = "\"lo\":" + to_string(added.lo) + ",\"hi\":" + to_string(added.hi);
+    string reply = shardPost(added, "/api/shard/import",
+                             "{\"source\":\"" + source.host + ":" + to_string(source.port) + "\"," + range + "}",
+                             SHARD_TRANSFER_TIMEOUT_MS);
+    if (reply.find("\"status\":\"success\"") == string::npos) {
+        lock_guard<mutex> lock(routeMutex);
+        shardRoutes[index].frozen = false;
+        shardRoutes[index].frozenLo = INT_MAX;
+        string reason = jsonString(reply, "message");
+        return createJSONResponse("error", "Target shard could not import the range" +
+                                           (reason.empty() ? string() : ": " + reason));
     }
     
-    int maxId = 0;
-    for (const auto& student : students) {
-        if (student.id > maxId) {
-            maxId = student.id;
+    // Writes to the range are frozen, so the source must still hold exactly
+    // what the target received; anything else means a lost transfer
+    int moved = jsonInt(reply, "moved", -1);
+    string info = shardGet(source, "/api/shard/info?lo=" + to_string(added.lo) + "&hi=" + to_string(added.hi));
+    int held = jsonInt(info, "count", -1);
+    if (info.find("\"status\":\"success\"") == string::npos || moved < 0 || held != moved) {
+        lock_guard<mutex> lock(routeMutex);
+        shardRoutes[index].frozen = false;
+        shardRoutes[index].frozenLo = INT_MAX;
+        return createJSONResponse("error", "Target shard received " + to_string(moved) + " records but the source holds " +
+                                           (held < 0 ? string("an unknown number") : to_string(held)));
+    }
+    range += ",\"expect\":" + to_string(moved);
+    
+    // Fan-out reads are held off until the source has dropped the range,
+    // so none of them counts it on both shards
+    bool dropped;
+    {
+        unique_lock<shared_timed_mutex> exclusive(splitLock);
+        {
+            lock_guard<mutex> lock(routeMutex);
+            shardRoutes[index].hi = at - 1;
+            shardRoutes[index].frozen = false;
+            shardRoutes[index].frozenLo = INT_MAX;
+            shardRoutes.insert(shardRoutes.begin() + index + 1, added);
         }
+        dropped = shardPost(source, "/api/shard/drop", "{" + range + "}", SHARD_TRANSFER_TIMEOUT_MS)
+                      .find("\"status\":\"success\"") != string::npos;
+    }
+    if (!dropped) {
+        cerr << "Split: " << source.host << ":" << source.port << " still holds ids " << added.lo << "-"
+             << added.hi << "; call /api/shard/drop on it\n";
     }
     
-    return maxId + 1;
+    cout << "Split ids " << added.lo << "-" << added.hi << " onto " << target << "\n";
+    string result = "{\"moved\":" + to_string(moved) + ",";
+    result += "\"sourceRange\":\"" + to_string(source.lo) + "-" + to_string(at - 1) + "\",";
+    result += "\"targetRange\":\"" + to_string(added.lo) + "-" + to_string(added.hi) + "\",";
+    result += "\"sourceDropped\":" + string(dropped ? "true" : "false") + "}";
+    return createJSONResponse("success", "Shard split", result);
+}
+
+// GET /api/shard/map (router)
+string shardMapAPI() {
+    lock_guard<mutex> lock(routeMutex);
+    
+    string jsonArray = "[";
+    for (size_t i = 0; i < shardRoutes.size(); i++) {
+        if (i > 0) {
+            jsonArray += ",";
+        }
+        jsonArray += "{\"lo\":" + to_string(shardRoutes[i].lo) + ",\"hi\":" + to_string(shardRoutes[i].hi) +
+                     ",\"shard\":\"" + shardRoutes[i].host + ":" + to_string(shardRoutes[i].port) + "\"" +
+                     ",\"splitting\":" + (shardRoutes[i].frozen ? "true" : "false") + "}";
+    }
+    jsonArray += "]";
+    
+    return createJSONResponse("success", "Shard map", jsonArray);
+}
+
+// Inside of the "data":[...] array of a createJSONResponse body
+string jsonDataArray(const string& body) {
+    size_t start = body.find("\"data\":[");
+    size_t end = body.rfind(']');
+    if (start == string::npos || end == string::npos || end < start + 8) {
+        return "";
+    }
+    return body.substr(start + 8, end - start - 8);
+}
+
+// Splits "{...},{...}" into objects; braces inside strings are ignored
+vector<string> splitJSONObjects(const string& array) {
+    vector<string> objects;
+    int depth = 0;
+    bool inString = false;
+    size_t start = 0;
+    for (size_t i = 0; i < array.size(); i++) {
+        char c = array[i];
+        if (inString) {
+            if (c == '\\') i++;
+            else if (c == '"') inString = false;
+        } else if (c == '"') {
+            inString = true;
+        } else if (c == '{') {
+            if (depth++ == 0) start = i;
+        } else if (c == '}' && --depth == 0) {
+            objects.push_back(array.substr(start, i - start + 1));
+        }
+    }
+    return objects;
+}
+
+Student studentFromJSON(const string& object) {
+    Student student;
+    student.id = jsonInt(object, "id");
+    student.name = jsonString(object, "name");
+    student.age = jsonInt(object, "age");
+    student.course = jsonString(object, "course");
+    student.email = jsonString(object, "email");
+    size_t pos = object.find("\"gpa\":");
+    student.gpa = (pos == string::npos) ? 0.0f : (float)atof(object.c_str() + pos + 6);
+    student.marks = jsonInt(object, "marks");
+    return student;
+}
+
+int jsonInt(const string& json, const string& field, int fallback) {
+    size_t pos = json.find("\"" + field + "\":");
+    if (pos == string::npos) {
+        return fallback;
+    }
+    pos += field.size() + 3;
+    while (pos < json.size() && (isspace((unsigned char)json[pos]) || json[pos] == '"')) {
+        pos++;
+    }
+    if (pos >= json.size() || !(isdigit((unsigned char)json[pos]) || json[pos] == '-')) {
+        return fallback;
+    }
+    return atoi(json.c_str() + pos);
+}
+
+string jsonString(const string& json, const string& field) {
+    size_t pos = json.find("\"" + field + "\":\"");
+    if (pos == string::npos) {
+        return "";
+    }
+    size_t start = pos + field.size() + 4;
+    return json.substr(start, json.find('"', start) - start);
+}
+
+string urlEncode(const string& text) {
+    static const char* hex = "0123456789ABCDEF";
+    string result;
+    for (unsigned char c : text) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            result += (char)c;
+        } else {
+            result += '%';
+            result += hex[c >> 4];
+            result += hex[c & 15];
+        }
+    }
+    return result;
+}
+
+// Returns the raw value of name=value in a query string, or "" if absent
+string getQueryParam(const string& query, const string& name) {
+    size_t start = 0;
+    while (start <= query.size()) {
+        size_t end = query.find('&', start);
+        if (end == string::npos) end = query.size();
+        
+        string pair = query.substr(start, end - start);
+        size_t eq = pair.find('=');
+        if (eq != string::npos && pair.substr(0, eq) == name) {
+            return pair.substr(eq + 1);
+        }
+        start = end + 1;
+    }
+    return "";
+}
+
+string urlDecode(const string& text) {
+    string result;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '+') {
+            result += ' ';
+        } else if (text[i] == '%' && i + 2 < text.size()) {
+            result += (char)strtol(text.substr(i + 1, 2).c_str(), nullptr, 16);
+            i += 2;
+        } else {
+            result += text[i];
+        }
+    }
+    return result;
+}
+
+string studentToJSON(const Student& student) {
+    string json = "{";
+    json += "\"id\":" + to_string(student.id) + ",";
+    json += "\"name\":\"" + student.name + "\",";
+    json += "\"age\":" + to_string(student.age) + ",";
+    json += "\"course\":\"" + student.course + "\",";
+    json += "\"email\":\"" + student.email + "\",";
+    json += "\"gpa\":" + to_string(student.gpa) + ",";
+    json += "\"marks\":" + to_string(student.marks);
+    json += "}";
+    return json;
 }
 
 string createJSONResponse(const string& status, const string& message, const string& data) {
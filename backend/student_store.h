@@ -0,0 +1,709 @@
+// Student storage shared by the console tool (main.cpp) and the HTTP server
+// (server.cpp).
+//
+// The records live in a named shared-memory region that every process
+// running against the same students.txt maps. A cross-process lock guards
+// it, and a change version in the header is bumped on every write. A
+// process can check that version with one load to tell whether someone
+// else changed the data, then copy the records straight out of the region
+// without parsing the text file again.
+//
+// students.txt remains the durable copy and keeps its format. Each write
+// persists the text file first and only then updates the region and bumps
+// the version, all under the same lock, so a failed write changes nothing
+// and a reader that sees a new version never waits on disk I/O.
+// Records must fit the fixed slots: oversized fields and more than
+// CAPACITY records are rejected rather than truncated.
+// The process that creates the region fills it from students.txt. If the
+// file is later changed outside SRMS (its size or modification time no
+// longer match the last write), the region is reloaded from it before the
+// next read or write, so hand edits are neither missed nor overwritten.
+//
+// If a process dies holding the lock, the next one to take it reloads the
+// region from students.txt.
+//
+// POSIX: shm_open + robust process-shared pthread mutex; creation is
+//        serialized by an flock on /tmp/<region>.lock. Regions are never
+//        unlinked: each data file ever opened keeps a ~24 MB
+//        /dev/shm/srms_<hash> until reboot. Remove them by hand when no
+//        SRMS process is running.
+// Windows: named file mapping + named mutex (lives while any process has it)
+
+#ifndef SRMS_STUDENT_STORE_H
+#define SRMS_STUDENT_STORE_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "persistence.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// Student structure
+struct Student {
+    int id;
+    std::string name;
+    int age;
+    std::string course;
+    std::string email;
+    float gpa;
+    int marks;
+};
+
+// Parses one ID|Name|Age|Course|Email|GPA|Marks line; throws on bad numbers
+inline Student parseStudentRecord(const std::string& line) {
+    Student student;
+    std::stringstream ss(line);
+    std::string temp;
+
+    std::getline(ss, temp, '|');
+    student.id = std::stoi(temp);
+
+    std::getline(ss, student.name, '|');
+
+    std::getline(ss, temp, '|');
+    student.age = std::stoi(temp);
+
+    std::getline(ss, student.course, '|');
+    std::getline(ss, student.email, '|');
+
+    std::getline(ss, temp, '|');
+    student.gpa = std::stof(temp);
+
+    temp.clear();
+    std::getline(ss, temp, '|');
+    if (!temp.empty()) {
+        student.marks = std::stoi(temp);
+    } else {
+        student.marks = 0;
+    }
+
+    return student;
+}
+
+inline std::string formatStudentRecord(const Student& student) {
+    std::ostringstream line;
+    line << student.id << "|" << student.name << "|" << student.age << "|"
+         << student.course << "|" << student.email << "|" << student.gpa << "|" << student.marks << "\n";
+    return line.str();
+}
+
+// A repeated ID keeps its first record; the rank indexes and the by-ID
+// lookups must agree on exactly one record per ID
+inline std::vector<Student> loadStudentsFile(const std::string& path) {
+    std::vector<Student> students;
+    std::set<int> seen;
+    std::ifstream file(path.c_str());
+
+    if (file.is_open()) {
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty()) continue;
+            Student student = parseStudentRecord(line);
+            if (!seen.insert(student.id).second) {
+                std::cerr << path << ": skipping duplicate ID " << student.id << "\n";
+                continue;
+            }
+            students.push_back(student);
+        }
+        file.close();
+    }
+
+    return students;
+}
+
+// Fixed-size slot in the shared region (strings include the terminator)
+struct SharedStudentRecord {
+    int32_t id;
+    int32_t age;
+    float gpa;
+    int32_t marks;
+    char name[64];
+    char course[64];
+    char email[96];
+};
+
+struct SharedStoreHeader {
+    uint32_t magic;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t changeVersion;     // bumped after every write; read without the lock
+    int64_t fileSize;           // students.txt as last written by SRMS, to
+    int64_t fileModified;       // spot edits made outside SRMS
+#ifndef _WIN32
+    pthread_mutex_t lock;
+#endif
+};
+
+class StudentStore {
+public:
+    static const uint32_t MAGIC = 0x53524d53;   // "SRMS"
+    static const uint32_t CAPACITY = 100000;
+
+    StudentStore() : header(0), records(0), persistence(0) {
+#ifdef _WIN32
+        mapping = 0;
+        mutexHandle = 0;
+#else
+        regionFd = -1;
+#endif
+    }
+
+    ~StudentStore() {
+        size_t size = regionSize();
+#ifdef _WIN32
+        if (header) UnmapViewOfFile(header);
+        if (mapping) CloseHandle(mapping);
+        if (mutexHandle) CloseHandle(mutexHandle);
+#else
+        if (header) munmap(header, size);
+        if (regionFd >= 0) close(regionFd);
+#endif
+        (void)size;
+    }
+
+    // Attaches to (or creates) the region for dataFile. Writes to dataFile
+    // go through writer, which must outlive the store. Fails, with error()
+    // set, if dataFile holds records that don't fit.
+    bool open(const std::string& dataFile, PersistenceBackend* writer) {
+        filename = dataFile;
+        persistence = writer;
+        std::string name = regionName();
+        bool created = false;
+        bool loaded = true;
+
+#ifdef _WIN32
+        mutexHandle = CreateMutexA(NULL, FALSE, ("Local\\" + name + "_lock").c_str());
+        if (!mutexHandle) return fail("Could not create the lock for " + name);
+        bool abandoned = lockRegion();
+
+        size_t size = regionSize();
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                     (DWORD)((uint64_t)size >> 32), (DWORD)(size & 0xffffffff),
+                                     ("Local\\" + name).c_str());
+        if (!mapping) {
+            unlockRegion();
+            return fail("Could not create shared memory " + name);
+        }
+        created = GetLastError() != ERROR_ALREADY_EXISTS;
+        header = (SharedStoreHeader*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        if (!header) {
+            unlockRegion();
+            return fail("Could not map shared memory " + name + " (made by a build with another capacity?)");
+        }
+        records = (SharedStudentRecord*)(header + 1);
+        if (!created && header->magic == MAGIC && header->capacity != CAPACITY) {
+            unlockRegion();
+            return fail(capacityMismatch(name, header->capacity));
+        }
+        // No magic: new, or its creator died before finishing
+        if (created || header->magic != MAGIC) {
+            created = true;
+            header->capacity = CAPACITY;
+            header->changeVersion = 0;
+            header->count = 0;
+            loaded = reloadFromFile();
+            header->magic = MAGIC;
+        } else if (abandoned) {
+            loaded = reloadFromFile();
+        }
+        unlockRegion();
+#else
+        // Creating or checking the region happens under an flock on a
+        // sidecar file. A creator that dies half way drops the lock with it
+        // and leaves a region without its magic value, which the next
+        // process recognises and rebuilds instead of waiting on it.
+        std::string lockPath = "/tmp/" + name + ".lock";
+        int lockFd = ::open(lockPath.c_str(), O_RDWR | O_CREAT, 0600);
+        if (lockFd < 0 || flock(lockFd, LOCK_EX) != 0) {
+            std::string reason = strerror(errno);
+            if (lockFd >= 0) close(lockFd);
+            return fail("Could not lock " + lockPath + ": " + reason);
+        }
+        bool attached = attachRegion("/" + name, created, loaded);
+        flock(lockFd, LOCK_UN);
+        close(lockFd);
+        if (!attached) return false;
+#endif
+
+        if (!created) {
+            lockRegion();
+            loaded = syncFile();
+            unlockRegion();
+        }
+        return loaded;
+    }
+
+    // Whether a record can be stored without cutting any field short
+    static bool fits(const Student& student) {
+        SharedStudentRecord record;
+        return student.name.size() < sizeof(record.name) &&
+               student.course.size() < sizeof(record.course) &&
+               student.email.size() < sizeof(record.email);
+    }
+
+    // Why the last open/add/update/remove/transaction failed
+    const std::string& error() const {
+        return lastError;
+    }
+
+    // Changes whenever any process writes; one atomic load, no lock
+    uint64_t version() const {
+        return __atomic_load_n(&header->changeVersion, __ATOMIC_ACQUIRE);
+    }
+
+    // Reloads the region if students.txt was edited outside SRMS. One stat
+    // when it wasn't; never waits: if the lock is busy, the writer holding
+    // it checks the file itself.
+    void reloadIfFileChanged() {
+        if (!fileChangedOutside() || !tryLockRegion()) {
+            return;
+        }
+        syncFile();
+        unlockRegion();
+    }
+
+    std::vector<Student> readAll(uint64_t* versionOut = 0) {
+        lockRegion();
+        syncFile();
+        std::vector<Student> students = copyOut();
+        if (versionOut) *versionOut = header->changeVersion;
+        unlockRegion();
+        return students;
+    }
+
+    // Like readAll, but gives up instead of waiting if another writer holds
+    // the lock
+    bool tryReadAll(std::vector<Student>& students, uint64_t* versionOut = 0) {
+        if (!tryLockRegion()) {
+            return false;
+        }
+        syncFile();
+        students = copyOut();
+        if (versionOut) *versionOut = header->changeVersion;
+        unlockRegion();
+        return true;
+    }
+
+    // An id of 0 is replaced by the next free id. Fails on duplicate ids,
+    // oversized fields, a full region or a failed write.
+    bool add(Student& student) {
+        lockRegion();
+        bool ok = syncFile() && check(student) && checkCapacity(header->count + 1);
+        int maxId = 1000;
+        for (uint32_t i = 0; ok && i < header->count; i++) {
+            if (records[i].id == student.id) ok = fail("ID already exists");
+            if (records[i].id > maxId) maxId = records[i].id;
+        }
+        if (ok) {
+            if (student.id == 0) {
+                student.id = maxId + 1;
+            }
+            ok = persistence->append(filename, formatStudentRecord(student)) || fail("Could not write " + filename);
+        }
+        if (ok) {
+            copyIn(records[header->count], student);
+            header->count++;
+            rememberFile();
+            bumpVersion();
+        }
+        unlockRegion();
+        return ok;
+    }
+
+    // Replaces the record with student.id; before receives the old values
+    bool update(Student& student, Student* before = 0) {
+        lockRegion();
+        bool ok = syncFile();
+        int index = findIndex(student.id);
+        ok = ok && (index >= 0 || fail("Student not found")) && check(student);
+        if (ok) {
+            std::vector<Student> students = copyOut();
+            students[index] = student;
+            ok = persistRecords(students);
+        }
+        if (ok) {
+            if (before) *before = copyOut(records[index]);
+            copyIn(records[index], student);
+            bumpVersion();
+        }
+        unlockRegion();
+        return ok;
+    }
+
+    bool remove(int id, Student* removed = 0) {
+        lockRegion();
+        bool ok = syncFile();
+        int index = findIndex(id);
+        ok = ok && (index >= 0 || fail("Student not found"));
+        if (ok) {
+            std::vector<Student> students = copyOut();
+            students.erase(students.begin() + index);
+            ok = persistRecords(students);
+        }
+        if (ok) {
+            if (removed) *removed = copyOut(records[index]);
+            memmove(&records[index], &records[index + 1],
+                    (header->count - index - 1) * sizeof(SharedStudentRecord));
+            header->count--;
+            bumpVersion();
+        }
+        unlockRegion();
+        return ok;
+    }
+
+    // Runs fn over all records with the lock held for the whole call, so
+    // the read-modify-write can't interleave with other writers. fn returns
+    // true if it changed the vector, which is then written back once.
+    // Keep fn short: it runs with every other writer waiting.
+    template <class Fn>
+    bool transaction(Fn fn) {
+        lockRegion();
+        if (!syncFile()) {
+            unlockRegion();
+            return false;
+        }
+        std::vector<Student> students = copyOut();
+        bool changed = fn(students);
+        bool ok = true;
+        if (changed) {
+            ok = checkCapacity(students.size());
+            for (size_t i = 0; ok && i < students.size(); i++) {
+                ok = check(students[i]);
+            }
+            ok = ok && persistRecords(students);
+            if (ok) {
+                for (size_t i = 0; i < students.size(); i++) {
+                    copyIn(records[i], students[i]);
+                }
+                header->count = (uint32_t)students.size();
+                bumpVersion();
+            }
+        }
+        unlockRegion();
+        return ok;
+    }
+
+private:
+    SharedStoreHeader* header;
+    SharedStudentRecord* records;
+    PersistenceBackend* persistence;
+    std::string filename;
+    std::string lastError;
+#ifdef _WIN32
+    HANDLE mapping;
+    HANDLE mutexHandle;
+#else
+    int regionFd;
+#endif
+
+    static size_t regionSize() {
+        return sizeof(SharedStoreHeader) + (size_t)CAPACITY * sizeof(SharedStudentRecord);
+    }
+
+    static std::string capacityMismatch(const std::string& name, uint32_t capacity) {
+        return "Shared memory " + name + " was made by an SRMS build with capacity " + std::to_string(capacity) +
+               "; stop the other SRMS processes or remove the region";
+    }
+
+#ifndef _WIN32
+    // Callers hold the creation flock, so no other process is creating or
+    // checking the region at the same time
+    bool attachRegion(const std::string& shmName, bool& created, bool& loaded) {
+        regionFd = shm_open(shmName.c_str(), O_RDWR | O_CREAT, 0600);
+        struct stat info;
+        if (regionFd < 0 || fstat(regionFd, &info) != 0) {
+            return fail("Could not open shared memory " + shmName + ": " + strerror(errno));
+        }
+
+        if (info.st_size > 0) {
+            uint32_t magic = 0, capacity = 0;
+            if ((size_t)info.st_size >= sizeof(SharedStoreHeader)) {
+                void* peek = mmap(0, sizeof(SharedStoreHeader), PROT_READ, MAP_SHARED, regionFd, 0);
+                if (peek != MAP_FAILED) {
+                    magic = ((SharedStoreHeader*)peek)->magic;
+                    capacity = ((SharedStoreHeader*)peek)->capacity;
+                    munmap(peek, sizeof(SharedStoreHeader));
+                }
+            }
+            if (magic == MAGIC && (capacity != CAPACITY || (size_t)info.st_size != regionSize())) {
+                return fail(capacityMismatch(shmName, capacity));
+            }
+            if (magic != MAGIC) {
+                // Left by a creator that died; nobody ever attached to it
+                close(regionFd);
+                shm_unlink(shmName.c_str());
+                regionFd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+                if (regionFd < 0) {
+                    return fail("Could not recreate shared memory " + shmName + ": " + strerror(errno));
+                }
+                info.st_size = 0;
+            }
+        }
+
+        created = (info.st_size == 0);
+        if (created && ftruncate(regionFd, regionSize()) != 0) {
+            return fail("Could not size shared memory " + shmName + ": " + strerror(errno));
+        }
+        void* base = mmap(0, regionSize(), PROT_READ | PROT_WRITE, MAP_SHARED, regionFd, 0);
+        if (base == MAP_FAILED) {
+            return fail("Could not map shared memory " + shmName + ": " + strerror(errno));
+        }
+        header = (SharedStoreHeader*)base;
+        records = (SharedStudentRecord*)(header + 1);
+
+        if (created) {
+            pthread_mutexattr_t attr;
+            pthread_mutexattr_init(&attr);
+            pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+            pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+            pthread_mutex_init(&header->lock, &attr);
+            pthread_mutexattr_destroy(&attr);
+
+            header->capacity = CAPACITY;
+            header->changeVersion = 0;
+            loaded = reloadFromFile();
+            __atomic_store_n(&header->magic, MAGIC, __ATOMIC_RELEASE);
+        }
+        return true;
+    }
+#endif
+
+    // One region per data file, keyed by a hash of its absolute path
+    std::string regionName() const {
+        std::string path = filename;
+#ifdef _WIN32
+        char full[MAX_PATH];
+        if (GetFullPathNameA(filename.c_str(), MAX_PATH, full, NULL)) path = full;
+#else
+        char* full = realpath(filename.c_str(), NULL);
+        if (!full) {
+            // The file may not exist yet; resolve its directory instead
+            char* dir = realpath(".", NULL);
+            if (dir && filename[0] != '/') path = std::string(dir) + "/" + filename;
+            free(dir);
+        } else {
+            path = full;
+            free(full);
+        }
+#endif
+        unsigned long long hash = 14695981039346656037ULL;
+        for (unsigned char c : path) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "srms_%016llx", hash);
+        return buffer;
+    }
+
+    // True if the previous holder died holding the lock. The region is then
+    // reloaded from students.txt, since the holder may have died between
+    // persisting a write and applying it to the region.
+    bool lockRegion() {
+#ifdef _WIN32
+        bool abandoned = WaitForSingleObject(mutexHandle, INFINITE) == WAIT_ABANDONED;
+#else
+        bool abandoned = pthread_mutex_lock(&header->lock) == EOWNERDEAD;
+        if (abandoned) {
+            pthread_mutex_consistent(&header->lock);
+        }
+#endif
+        if (abandoned) {
+            recoverAbandoned();
+        }
+        return abandoned;
+    }
+
+    bool tryLockRegion() {
+#ifdef _WIN32
+        DWORD result = WaitForSingleObject(mutexHandle, 0);
+        bool abandoned = result == WAIT_ABANDONED;
+        bool locked = result == WAIT_OBJECT_0 || abandoned;
+#else
+        int result = pthread_mutex_trylock(&header->lock);
+        bool abandoned = result == EOWNERDEAD;
+        if (abandoned) {
+            pthread_mutex_consistent(&header->lock);
+        }
+        bool locked = result == 0 || abandoned;
+#endif
+        if (abandoned) {
+            recoverAbandoned();
+        }
+        return locked;
+    }
+
+    // students.txt is the durable copy, so it wins over whatever the dead
+    // holder left in the region. Before the region is mapped (Windows open)
+    // there is nothing to fix yet; open() reloads itself.
+    void recoverAbandoned() {
+        if (header && header->magic == MAGIC) {
+            reloadFromFile();
+        }
+    }
+
+    void unlockRegion() {
+#ifdef _WIN32
+        ReleaseMutex(mutexHandle);
+#else
+        pthread_mutex_unlock(&header->lock);
+#endif
+    }
+
+    void bumpVersion() {
+        __atomic_store_n(&header->changeVersion, header->changeVersion + 1, __ATOMIC_RELEASE);
+    }
+
+    int findIndex(int id) const {
+        for (uint32_t i = 0; i < header->count; i++) {
+            if (records[i].id == id) return (int)i;
+        }
+        return -1;
+    }
+
+    bool fail(const std::string& reason) {
+        lastError = reason;
+        return false;
+    }
+
+    bool check(const Student& student) {
+        return fits(student) || fail(student.id ? "Name, course or email is too long for ID " + std::to_string(student.id)
+                                                : std::string("Name, course or email is too long"));
+    }
+
+    bool checkCapacity(size_t count) {
+        return count <= header->capacity || fail("Store is full");
+    }
+
+    // Callers check fits() first, so nothing is cut short here
+    static void copyString(char* target, size_t size, const std::string& value) {
+        size_t length = value.size() < size - 1 ? value.size() : size - 1;
+        memcpy(target, value.data(), length);
+        target[length] = '\0';
+    }
+
+    static void copyIn(SharedStudentRecord& record, const Student& student) {
+        record.id = student.id;
+        record.age = student.age;
+        record.gpa = student.gpa;
+        record.marks = student.marks;
+        copyString(record.name, sizeof(record.name), student.name);
+        copyString(record.course, sizeof(record.course), student.course);
+        copyString(record.email, sizeof(record.email), student.email);
+    }
+
+    static Student copyOut(const SharedStudentRecord& record) {
+        Student student;
+        student.id = record.id;
+        student.age = record.age;
+        student.gpa = record.gpa;
+        student.marks = record.marks;
+        student.name = record.name;
+        student.course = record.course;
+        student.email = record.email;
+        return student;
+    }
+
+    std::vector<Student> copyOut() const {
+        std::vector<Student> students;
+        students.reserve(header->count);
+        for (uint32_t i = 0; i < header->count; i++) {
+            students.push_back(copyOut(records[i]));
+        }
+        return students;
+    }
+
+    // Callers hold the lock. A file that doesn't fit the region is left
+    // alone (the store refuses to open, and writes are refused) rather than
+    // loaded partially, which the next write would then make permanent.
+    // The region keeps what it held, and the file is retried on next access.
+    bool reloadFromFile() {
+        std::vector<Student> students = loadStudentsFile(filename);
+        bool ok = checkCapacity(students.size());
+        for (size_t i = 0; ok && i < students.size(); i++) {
+            ok = check(students[i]);
+        }
+        if (!ok) {
+            __atomic_store_n(&header->fileSize, (int64_t)-2, __ATOMIC_RELEASE);
+            return false;
+        }
+        for (size_t i = 0; i < students.size(); i++) {
+            copyIn(records[i], students[i]);
+        }
+        header->count = (uint32_t)students.size();
+        rememberFile();
+        bumpVersion();
+        return true;
+    }
+
+    // Callers hold the lock. False if the file changed and could not be
+    // loaded; writes then refuse rather than overwrite it.
+    bool syncFile() {
+        return !fileChangedOutside() || reloadFromFile();
+    }
+
+    bool persistRecords(const std::vector<Student>& students) {
+        std::string data;
+        for (size_t i = 0; i < students.size(); i++) {
+            data += formatStudentRecord(students[i]);
+        }
+        if (!persistence->writeSnapshot(filename, data)) {
+            return fail("Could not write " + filename);
+        }
+        rememberFile();
+        return true;
+    }
+
+    // Nanoseconds where the platform has them, so two edits in the same
+    // second are still told apart
+    static int64_t modifiedTime(const struct stat& info) {
+#if defined(__linux__)
+        return (int64_t)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+        return (int64_t)info.st_mtimespec.tv_sec * 1000000000LL + info.st_mtimespec.tv_nsec;
+#else
+        return (int64_t)info.st_mtime;
+#endif
+    }
+
+    // Atomic so reloadIfFileChanged can compare without the lock
+    void rememberFile() {
+        struct stat info;
+        bool exists = stat(filename.c_str(), &info) == 0;
+        __atomic_store_n(&header->fileSize, exists ? (int64_t)info.st_size : (int64_t)-1, __ATOMIC_RELEASE);
+        __atomic_store_n(&header->fileModified, exists ? modifiedTime(info) : (int64_t)0, __ATOMIC_RELEASE);
+    }
+
+    bool fileChangedOutside() const {
+        int64_t size = __atomic_load_n(&header->fileSize, __ATOMIC_ACQUIRE);
+        int64_t modified = __atomic_load_n(&header->fileModified, __ATOMIC_ACQUIRE);
+        struct stat info;
+        if (stat(filename.c_str(), &info) != 0) {
+            return size != -1;
+        }
+        return (int64_t)info.st_size != size || modifiedTime(info) != modified;
+    }
+};
+
+#endif
@@ -1,5 +1,7 @@
 // API Configuration
-const API_BASE_URL = 'http://localhost:8080/api';
+// Same origin when the pages are served by server.cpp (no CORS preflights);
+// the absolute URL is only needed when opening the HTML files directly
+const API_BASE_URL = window.location.protocol === 'file:' ? 'http://localhost:8080/api' : '/api';
 
 // API Functions
 
@@ -95,6 +97,33 @@ async function searchStudent(id) {
     }
 }
 
+/**
+ * Fetch the top students by a metric, ranked on the server
+ * @param {number} k - Number of students to return
+ * @param {string} by - Ranking metric ('marks' or 'gpa')
+ * @returns {Promise<Array>} Array of student objects, best first
+ */
+async function fetchTopStudents(k, by = 'marks') {
+    try {
+        const response = await fetch(`${API_BASE_URL}/students/top?by=${by}&k=${k}`);
+        
+        if (!response.ok) {
+            throw new Error(`HTTP error! status: ${response.status}`);
+        }
+        
+        const result = await response.json();
+        
+        if (result.status === 'success') {
+            return result.data;
+        } else {
+            throw new Error(result.message || 'Failed to fetch top students');
+        }
+    } catch (error) {
+        console.error('Error fetching top students:', error);
+        throw error;
+    }
+}
+
 /**
  * Update student information
  * @param {number} id - Student ID
@@ -254,6 +283,7 @@ document.head.appendChild(style);
 window.fetchStudents = fetchStudents;
 window.addStudent = addStudent;
 window.searchStudent = searchStudent;
+window.fetchTopStudents = fetchTopStudents;
 window.updateStudent = updateStudent;
 window.deleteStudent = deleteStudent;
 window.formatGPA = formatGPA;